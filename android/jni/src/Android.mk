@@ -10,7 +10,7 @@ LOCAL_CFLAGS += -g -std=c99
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(SDL_PATH)/include
 
-YOUR_SRC_FILES= game_aux.c game_ext.c game_private.c game_sdl.c game_solve.c game_tools.c game.c graphics.c queue.c
+YOUR_SRC_FILES= game_aux.c game_ext.c game_journal.c game_private.c game_sdl.c game_solve.c game_solver.c game_tools.c game.c graphics.c queue.c
 
 LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c $(YOUR_SRC_FILES)
 
@@ -0,0 +1 @@
+../../../game_journal.c
\ No newline at end of file
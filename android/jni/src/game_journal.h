@@ -0,0 +1 @@
+../../../game_journal.h
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "game.h"
 #include "game_aux.h"
@@ -36,62 +37,81 @@ static char* _textures_names[] = {"redstone_lamp_off.png",
 Env* init(SDL_Window* win, SDL_Renderer* ren, int argc, char* argv[])
 {
   Env* env = malloc(sizeof(struct Env_t));
-  env->scale = 1;
-
-  int w, h;
-  SDL_GetWindowSize(win, &w, &h);
-  env->textures = malloc(sizeof(SDL_Texture*) * (TEXTURE_COUNT + BUTTON_COUNT));
-  /* init all textures from PNG images */
-  for (int i = 0; i < TEXTURE_COUNT + BUTTON_COUNT; i++) {
-    env->textures[i] = IMG_LoadTexture(ren, _textures_names[i]);
-    if (!env->textures[i]) ERROR("IMG_LoadTexture: %s : %s\n", _textures_names[i], SDL_GetError());
-  }
-
-  /* init all text textures */
-  SDL_Color color_gray = {204, 201, 221, 0};
-  SDL_Color color_black = {0, 0, 0, 0};
-  SDL_Color color;
-  TTF_Font* font_arial = TTF_OpenFont(FONT, FONTSIZE);
-  if (!font_arial) ERROR("TTF_OpenFont: %s\n", FONT);
-  TTF_Font* font_minecraft = TTF_OpenFont(FONT_MC, FONTSIZE);
-  if (!font_minecraft) ERROR("TTF_OpenFont: %s\n", FONT_MC);
-  TTF_Font* font;
-  TTF_SetFontStyle(font_arial, TTF_STYLE_BOLD);
-  env->texts = malloc(sizeof(SDL_Texture*) * TEXT_COUNT);
-  for (int i = 0; i < TEXT_COUNT; i++) {
-    if (i == TEXT_WINNING) {
-      color = color_gray;
-    } else {
-      color = color_black;
-    }
-    if (i == TEXT_WINNING || i == TEXT_TITLE) {
-      font = font_minecraft;
+  env->zoom = 1;
+  env->cam_x = env->cam_y = 0;
+  env->pressed = env->dragged = false;
+
+  /* the images are decoded and the texts rendered on a worker thread, and
+   * uploaded by render() once they are ready: see _load_assets() */
+  env->startup_log = false;
+  env->loading = true;
+  SDL_AtomicSet(&env->loaded, 0);
+  /* SDL_image sets up its PNG loader on the first load, which is not thread
+   * safe: it is set up, and the icon loaded, before the loader thread starts */
+  if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) ERROR("IMG_Init: %s\n", SDL_GetError());
+  SDL_Surface* icon = IMG_Load("textures/icon.png");
+  SDL_SetWindowIcon(win, icon);
+  env->loader = SDL_CreateThread(_load_assets, "assets", env);
+  if (!env->loader) ERROR("SDL_CreateThread: %s\n", SDL_GetError());
+  env->atlas = env->background = NULL;
+  env->texts = calloc(TEXT_COUNT, sizeof(SDL_Texture*));
+  if (!env->texts) ERROR("Error: calloc\n");
+  env->batch = NULL;
+  env->batch_indices = NULL;
+  env->batch_len = env->batch_capacity = 0;
+  env->bar_start_w = env->bar_start_h = env->bar_scale = 0;
+
+  /* performance statistics, dumped to a CSV file with -p <file> */
+  env->hud = false;
+  env->nb_frames = 0;
+  env->render_ms = env->process_ms = env->engine_ms = 0;
+  env->draw_calls = 0;
+  env->engine_call = NULL;
+  env->engine_logged = true;
+  env->csv = NULL;
+  /* options: [-p <file.csv>] [-t] [<game file>], -t prints the startup times */
+  int a = 1;
+  for (; a < argc && argv[a][0] == '-'; a++) {
+    if (strcmp(argv[a], "-t") == 0) {
+      env->startup_log = true;
+    } else if (strcmp(argv[a], "-p") == 0 && a + 1 < argc) {
+      env->csv = fopen(argv[++a], "w");
+      if (!env->csv) ERROR("Error: fopen %s\n", argv[a]);
+      fprintf(env->csv, "frame,time_ms,process_ms,render_ms,frame_ms,draw_calls,engine_call,engine_ms\n");
     } else {
-      font = font_arial;
+      ERROR("Usage: %s [-p <file.csv>] [-t] [<game file>]\n", argv[0]);
     }
-    SDL_Surface* surf = TTF_RenderText_Blended(font, _texts_strings[i], color);
-    env->texts[i] = SDL_CreateTextureFromSurface(ren, surf);
-    SDL_FreeSurface(surf);
   }
 
-  TTF_CloseFont(font_arial);
-  TTF_CloseFont(font_minecraft);
-
   // game init
   game g = NULL;
-  if (argc == 2)
-    g = game_load(argv[1]);
+  if (a == argc - 1)
+    g = game_load(argv[a]);
   else {
-    srand(time(NULL));  // initialize radom seed with current time
-    g = game_random(7, 7, false, 10, false);
+    g = game_random_seeded(7, 7, false, 10, false, (uint64_t)time(NULL));
   }
 
   env->g = g;
   env->btn_mark_switch = false;
   // _reserve_audio(env);
-  SDL_Surface* icon = IMG_Load("textures/icon.png");
-  SDL_SetWindowIcon(win, icon);
   env->woncount = 1;
+  env->redraw = true;
+
+  /* the grid is rendered into a texture, in which only the squares that
+   * changed are rendered again */
+  SDL_RendererInfo info;
+  env->board = NULL;
+  env->board_w = env->board_h = 0;
+  env->board_square_size = 0;
+  env->board_row0 = env->board_col0 = 0;
+  env->board_valid = false;
+  env->shown = NULL;
+  if (SDL_GetRendererInfo(ren, &info) == 0 && (info.flags & SDL_RENDERER_TARGETTEXTURE)) {
+    env->shown = malloc(sizeof(square) * g->nb_rows * g->nb_cols);
+    if (!env->shown) ERROR("Error: malloc\n");
+  }
+  env->animating = true;  // until the assets are uploaded
+  _startup_mark(env, "init");
   return env;
 }
 
@@ -99,37 +119,34 @@ Env* init(SDL_Window* win, SDL_Renderer* ren, int argc, char* argv[])
 
 void render(SDL_Window* win, SDL_Renderer* ren, Env* env)
 {
+  /* until the assets are ready, the frame is left empty */
+  if (env->loading && !_upload_assets(ren, env, false)) return;
   game g = env->g;
   /* get current window size */
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
-  SDL_RenderCopy(ren, env->textures[TEXTURE_BACKGROUND], NULL, NULL);
-
-  int square_width = (w - ((w * PADDING_X) / 100)) / g->nb_cols;
-  int square_height = (h - ((h * PADDING_Y) / 100)) / g->nb_rows;
-  square_width = square_width - (square_width % TEXTURES_SIZE);
-  square_height = square_height - (square_height % TEXTURES_SIZE);
-  int square_size;
-  if (square_width < TEXTURES_SIZE || square_height < TEXTURES_SIZE) {
-    square_size = TEXTURES_SIZE;
-  } else if (square_width > square_height) {
-    square_size = square_height;
+  SDL_RenderCopy(ren, env->background, NULL, NULL);
+  env->draw_calls = 1;
+
+  /* only the squares in the view are rendered */
+  _camera(env, w, h);
+  int square_size = env->square_size;
+  if (env->shown && _update_board(ren, env, square_size)) {
+    SDL_Rect src = {env->view.x - env->origin_x - square_size * env->board_col0,
+                    env->view.y - env->origin_y - square_size * env->board_row0, env->view.w, env->view.h};
+    SDL_RenderCopy(ren, env->board, &src, &env->view);
+    env->draw_calls++;
   } else {
-    square_size = square_width;
-  }
-  int padding_w = w - (square_size * g->nb_cols);
-  int padding_h = h - (square_size * g->nb_rows);
-
-  env->padding_w = padding_w;
-  env->padding_h = padding_h;
-  env->scale = square_size / TEXTURES_SIZE;
-
-  int texture_level[4];
-  for (uint i = 0; i < g->nb_rows; i++) {
-    for (uint j = 0; j < g->nb_cols; j++) {
-      _get_square_texture(g, i, j, texture_level);
-      _render_square(env, ren, i, j, square_size, texture_level);
+    int texture_level[4];
+    SDL_RenderSetClipRect(ren, &env->view);
+    for (uint i = env->row0; i < env->row1; i++) {
+      for (uint j = env->col0; j < env->col1; j++) {
+        _get_square_texture(g, i, j, texture_level);
+        _render_square(env, i, j, square_size, texture_level);
+      }
     }
+    _batch_flush(ren, env);
+    SDL_RenderSetClipRect(ren, NULL);
   }
   _bar_render(win, env, ren);
 
@@ -142,6 +159,7 @@ void render(SDL_Window* win, SDL_Renderer* ren, Env* env)
     //   env->woncount--;
     // }
   }
+  if (env->hud) _hud_render(win, env, ren);
 }
 
 /* **************************************************************** */
@@ -155,23 +173,64 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
   game g = env->g;
+  _camera(env, w, h);
+  /* the window must be rendered again after a resize, an expose, or when the
+   * GPU textures are lost (e.g. when an Android app comes back) */
+  if (e->type == SDL_WINDOWEVENT) {
+    Uint8 event = e->window.event;
+    if (event == SDL_WINDOWEVENT_SIZE_CHANGED || event == SDL_WINDOWEVENT_EXPOSED || event == SDL_WINDOWEVENT_RESTORED)
+      env->redraw = true;
+  }
+  if (e->type == SDL_RENDER_TARGETS_RESET || e->type == SDL_RENDER_DEVICE_RESET) {
+    env->redraw = true;
+    env->board_valid = false;  // the content of the board texture is lost
+  }
+  /* the wheel and a pinch zoom, a drag pans the grid, a click plays */
+  if (e->type == SDL_MOUSEWHEEL && e->wheel.y != 0) {
+    int x, y;
+    SDL_GetMouseState(&x, &y);
+    bool in = (e->wheel.direction == SDL_MOUSEWHEEL_FLIPPED) ? e->wheel.y < 0 : e->wheel.y > 0;
+    _zoom_at(env, w, h, in ? ZOOM_STEP : 1 / ZOOM_STEP, x, y);
+  }
+  if (e->type == SDL_MULTIGESTURE && e->mgesture.numFingers == 2) {
+    double factor = 1 + PINCH_SPEED * e->mgesture.dDist;
+    _zoom_at(env, w, h, factor < 0.5 ? 0.5 : factor, e->mgesture.x * w, e->mgesture.y * h);
+    env->dragged = true;  // the fingers are not a click
+  }
   if (e->type == SDL_MOUSEBUTTONDOWN) {
-    SDL_Point mouse;
-    SDL_GetMouseState(&mouse.x, &mouse.y);
-    int square_size = env->scale * TEXTURES_SIZE;
-    uint col = (mouse.x - (env->padding_w / 2)) / square_size;
-    uint row = (mouse.y - (env->padding_h / 2)) / square_size;
+    env->pressed = true;
+    env->dragged = false;
+    env->press_x = e->button.x;
+    env->press_y = e->button.y;
+  }
+  if (e->type == SDL_MOUSEMOTION && env->pressed) {
+    if (env->dragged) {
+      _pan(env, w, h, e->motion.xrel, e->motion.yrel);
+    } else if (abs(e->motion.x - env->press_x) + abs(e->motion.y - env->press_y) >= DRAG_THRESHOLD) {
+      env->dragged = true;
+      _pan(env, w, h, e->motion.x - env->press_x, e->motion.y - env->press_y);
+    }
+  }
+  if (e->type == SDL_MOUSEBUTTONUP && env->pressed && !env->dragged) {
+    env->redraw = true;
+    SDL_Point mouse = {e->button.x, e->button.y};
+    /* the square under the mouse, through the camera */
+    uint col = (uint)-1, row = (uint)-1;
+    if (SDL_PointInRect(&mouse, &env->view)) {
+      col = (mouse.x - env->origin_x) / env->square_size;
+      row = (mouse.y - env->origin_y) / env->square_size;
+    }
     switch (e->button.button) {
       case SDL_BUTTON_LEFT:
         if (mouse.y >= env->bar_start_h && mouse.y < env->bar_start_h + TEXTURES_SIZE * env->bar_scale) {
           int button_index = (mouse.x - env->bar_start_w) / (TEXTURES_SIZE * env->bar_scale);
           switch (button_index) {
             case 0:
-              game_undo(g);
+              ENGINE_CALL(env, "game_undo", game_undo(g));
               break;
             case 1:
               env->woncount = 1;
-              game_restart(g);
+              ENGINE_CALL(env, "game_restart", game_restart(g));
               break;
             case 2:
               if (env->btn_mark_switch) {
@@ -181,10 +240,10 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
               }
               break;
             case 3:
-              game_solve(g);
+              ENGINE_CALL(env, "game_solve", game_solve(g));
               break;
             case 4:
-              game_redo(g);
+              ENGINE_CALL(env, "game_redo", game_redo(g));
               break;
             default:
               break;
@@ -199,20 +258,25 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
         }
         switch (game_get_state(env->g, row, col)) {
           case S_BLANK:
-            if (game_check_move(env->g, row, col, chosenState)) game_play_move(env->g, row, col, chosenState);
+            if (game_check_move(env->g, row, col, chosenState))
+              ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, chosenState));
             break;
           case S_LIGHTBULB:
             if (chosenState == S_LIGHTBULB) {
-              if (game_check_move(env->g, row, col, S_BLANK)) game_play_move(env->g, row, col, S_BLANK);
+              if (game_check_move(env->g, row, col, S_BLANK))
+                ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, S_BLANK));
             } else {
-              if (game_check_move(env->g, row, col, chosenState)) game_play_move(env->g, row, col, chosenState);
+              if (game_check_move(env->g, row, col, chosenState))
+                ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, chosenState));
             }
             break;
           case S_MARK:
             if (chosenState == S_MARK) {
-              if (game_check_move(env->g, row, col, S_BLANK)) game_play_move(env->g, row, col, S_BLANK);
+              if (game_check_move(env->g, row, col, S_BLANK))
+                ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, S_BLANK));
             } else {
-              if (game_check_move(env->g, row, col, chosenState)) game_play_move(env->g, row, col, chosenState);
+              if (game_check_move(env->g, row, col, chosenState))
+                ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, chosenState));
             }
             break;
           default:
@@ -220,15 +284,19 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
         }
         break;
       case SDL_BUTTON_RIGHT:
+        if (row >= env->g->nb_rows || col >= env->g->nb_cols) break;
         switch (game_get_state(env->g, row, col)) {
           case S_BLANK:
-            if (game_check_move(env->g, row, col, S_MARK)) game_play_move(env->g, row, col, S_MARK);
+            if (game_check_move(env->g, row, col, S_MARK))
+              ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, S_MARK));
             break;
           case S_LIGHTBULB:
-            if (game_check_move(env->g, row, col, S_MARK)) game_play_move(env->g, row, col, S_MARK);
+            if (game_check_move(env->g, row, col, S_MARK))
+              ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, S_MARK));
             break;
           case S_MARK:
-            if (game_check_move(env->g, row, col, S_BLANK)) game_play_move(env->g, row, col, S_BLANK);
+            if (game_check_move(env->g, row, col, S_BLANK))
+              ENGINE_CALL(env, "game_play_move", game_play_move(env->g, row, col, S_BLANK));
           default:
             break;
         }
@@ -237,27 +305,32 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
         break;
     }
   }
+  if (e->type == SDL_MOUSEBUTTONUP) env->pressed = false;
   if (e->type == SDL_KEYDOWN) {
+    env->redraw = true;
     switch (e->key.keysym.sym) {
       case SDLK_ESCAPE:
         return true;
         break;
+      case SDLK_F3:
+        env->hud = !env->hud;
+        break;
       case SDLK_r:
         env->woncount = 1;
-        game_restart(env->g);
+        ENGINE_CALL(env, "game_restart", game_restart(env->g));
         break;
       case SDLK_s:
-        game_solve(env->g);
+        ENGINE_CALL(env, "game_solve", game_solve(env->g));
         break;
       case SDLK_z:
-        game_undo(env->g);
+        ENGINE_CALL(env, "game_undo", game_undo(env->g));
         break;
       case SDLK_y:
 
-        game_redo(env->g);
+        ENGINE_CALL(env, "game_redo", game_redo(env->g));
         break;
       case SDLK_w:
-        game_save(env->g, "GameSave.txt");
+        ENGINE_CALL(env, "game_save", game_save(env->g, "GameSave.txt"));
         break;
     }
   }
@@ -267,19 +340,31 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e)
 
 void clean(SDL_Window* win, SDL_Renderer* ren, Env* env)
 {
-  for (int i = 0; i < TEXTURE_COUNT + BUTTON_COUNT; i++) {
-    SDL_DestroyTexture(env->textures[i]);
-  }
-  free(env->textures);
+  SDL_DestroyTexture(env->atlas);
+  SDL_DestroyTexture(env->background);
+  free(env->batch);
+  free(env->batch_indices);
   for (int i = 0; i < TEXT_COUNT; i++) {
-    SDL_DestroyTexture(env->texts[i]);
+    if (env->texts[i]) SDL_DestroyTexture(env->texts[i]);
   }
   free(env->texts);
+  if (env->board) SDL_DestroyTexture(env->board);
+  free(env->shown);
+  if (env->loading) {  // closed before the assets were uploaded
+    SDL_WaitThread(env->loader, NULL);
+    SDL_FreeSurface(env->assets.atlas);
+    SDL_FreeSurface(env->assets.background);
+    SDL_FreeSurface(env->assets.title);
+  }
+  TTF_CloseFont(env->assets.font_mc);
+  TTF_CloseFont(env->assets.hud_font);
+  if (env->csv) fclose(env->csv);
   game_delete(env->g);
   // Mix_FreeMusic(env->ost);
   // Mix_FreeChunk(env->won);
   // Mix_CloseAudio();
   free(env);
+  IMG_Quit();
   SDL_DestroyRenderer(ren);
   SDL_DestroyWindow(win);
 }
@@ -329,28 +414,365 @@ void _get_square_texture(cgame g, uint i, uint j, int* texture_level)
   }
 }
 
-void _render_square(Env* env, SDL_Renderer* ren, uint i, uint j, int square_size, int* texture_level)
+void _render_square(Env* env, uint i, uint j, int square_size, int* texture_level)
+{
+  int x = env->origin_x + (square_size * j);
+  int y = env->origin_y + (square_size * i);
+  _render_square_at(env, x, y, square_size, texture_level);
+}
+
+void _render_square_at(Env* env, int x, int y, int square_size, int* texture_level)
 {
   for (int level = 0; level < 4; level++) {
     if (texture_level[level] != -1) {
-      int x = (env->padding_w / 2) + (square_size * j);
-      int y = (env->padding_h / 2) + (square_size * i);
-      if (level == 2) {
-        _render_texture(ren, env->texts[texture_level[level]], TEXTURES_SIZE * env->scale, TEXTURES_SIZE * env->scale,
-                        x, y);
-      } else {
-        _render_texture(ren, env->textures[texture_level[level]], TEXTURES_SIZE * env->scale,
-                        TEXTURES_SIZE * env->scale, x, y);
-      }
+      int tile = (level == 2) ? TILE_TEXT(texture_level[level]) : texture_level[level];
+      _batch_tile(env, tile, x, y, square_size);
+    }
+  }
+}
+
+SDL_Rect _tile_rect(int tile)
+{
+  SDL_Rect rect = {(tile % ATLAS_COLS) * ATLAS_TILE, (tile / ATLAS_COLS) * ATLAS_TILE, ATLAS_TILE, ATLAS_TILE};
+  return rect;
+}
+
+void _atlas_put(SDL_Surface* atlas, int tile, SDL_Surface* surf)
+{
+  SDL_Rect rect = _tile_rect(tile);
+  SDL_SetSurfaceBlendMode(surf, SDL_BLENDMODE_NONE);  // copies the alpha channel as is
+  if (SDL_BlitScaled(surf, NULL, atlas, &rect) != 0) ERROR("SDL_BlitScaled: %s\n", SDL_GetError());
+}
+
+/* adds a size x size quad at (x, y), textured with a tile of the atlas */
+void _batch_tile(Env* env, int tile, int x, int y, int size)
+{
+  if (env->batch_len == env->batch_capacity) {
+    int capacity = env->batch_capacity ? 2 * env->batch_capacity : 256;
+    env->batch = realloc(env->batch, sizeof(SDL_Vertex) * 4 * capacity);
+    env->batch_indices = realloc(env->batch_indices, sizeof(int) * 6 * capacity);
+    if (!env->batch || !env->batch_indices) ERROR("Error: realloc\n");
+    // two triangles per quad, on its corners 0 1 (top) and 2 3 (bottom)
+    static const int corners[6] = {0, 1, 2, 2, 1, 3};
+    for (int q = env->batch_capacity; q < capacity; q++)
+      for (int k = 0; k < 6; k++) env->batch_indices[6 * q + k] = 4 * q + corners[k];
+    env->batch_capacity = capacity;
+  }
+  SDL_Rect src = _tile_rect(tile);
+  SDL_Vertex* v = &env->batch[4 * env->batch_len++];
+  for (int k = 0; k < 4; k++) {
+    int dx = k & 1, dy = k >> 1;
+    v[k].position.x = x + dx * size;
+    v[k].position.y = y + dy * size;
+    v[k].color.r = v[k].color.g = v[k].color.b = v[k].color.a = 0xFF;
+    v[k].tex_coord.x = (src.x + dx * ATLAS_TILE) / (float)ATLAS_W;
+    v[k].tex_coord.y = (src.y + dy * ATLAS_TILE) / (float)ATLAS_H;
+  }
+}
+
+/* draws the batch in a single call when SDL supports it, then empties it */
+void _batch_flush(SDL_Renderer* ren, Env* env)
+{
+  if (env->batch_len == 0) return;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+  SDL_RenderGeometry(ren, env->atlas, env->batch, 4 * env->batch_len, env->batch_indices, 6 * env->batch_len);
+  env->draw_calls++;
+#else
+  for (int q = 0; q < env->batch_len; q++) {
+    SDL_Vertex* v = &env->batch[4 * q];
+    SDL_Rect src = {v[0].tex_coord.x * ATLAS_W, v[0].tex_coord.y * ATLAS_H, ATLAS_TILE, ATLAS_TILE};
+    SDL_Rect dst = {v[0].position.x, v[0].position.y, v[3].position.x - v[0].position.x,
+                    v[3].position.y - v[0].position.y};
+    SDL_RenderCopy(ren, env->atlas, &src, &dst);
+  }
+  env->draw_calls += env->batch_len;
+#endif
+  env->batch_len = 0;
+}
+
+/* renders into the board texture the visible squares which changed since the
+ * last frame, the texture holds the squares of the view plus a partial one on
+ * each side: it is created again when the view or the zoom changes */
+bool _update_board(SDL_Renderer* ren, Env* env, int square_size)
+{
+  game g = env->g;
+  int w = square_size * SDL_min((int)g->nb_cols, env->view.w / square_size + 2);
+  int h = square_size * SDL_min((int)g->nb_rows, env->view.h / square_size + 2);
+  if (env->board && (env->board_w != w || env->board_h != h)) {
+    SDL_DestroyTexture(env->board);
+    env->board = NULL;
+  }
+  if (!env->board) {
+    env->board = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!env->board) return false;  // too large for the GPU: the squares are rendered directly
+    SDL_SetTextureBlendMode(env->board, SDL_BLENDMODE_NONE);
+    env->board_w = w;
+    env->board_h = h;
+    env->board_valid = false;
+  }
+  if (env->board_row0 != env->row0 || env->board_col0 != env->col0) {
+    env->board_row0 = env->row0;  // panned by a square or more
+    env->board_col0 = env->col0;
+    env->board_valid = false;
+  }
+  if (env->board_square_size != square_size) {
+    env->board_square_size = square_size;  // zoomed, the texture may keep its size
+    env->board_valid = false;
+  }
+  if (SDL_SetRenderTarget(ren, env->board) != 0) return false;
+  if (!env->board_valid) {
+    SDL_SetRenderDrawColor(ren, 0, 0, 0, 0xFF);
+    SDL_RenderClear(ren);
+  }
+  int texture_level[4];
+  for (uint i = env->row0; i < env->row1; i++) {
+    for (uint j = env->col0; j < env->col1; j++) {
+      square s = SQUARE(g, i, j);  // state and flags
+      square* shown = &env->shown[INDEX(g, i, j)];
+      if (env->board_valid && *shown == s) continue;
+      *shown = s;
+      int x = square_size * (j - env->col0);
+      int y = square_size * (i - env->row0);
+      _batch_tile(env, TILE_SOLID, x, y, square_size);
+      _get_square_texture(g, i, j, texture_level);
+      _render_square_at(env, x, y, square_size, texture_level);
     }
   }
+  _batch_flush(ren, env);
+  SDL_SetRenderTarget(ren, NULL);
+  env->board_valid = true;
+  return true;
+}
+
+void _camera(Env* env, int w, int h)
+{
+  game g = env->g;
+  int max_w = w - ((w * PADDING_X) / 100);
+  int max_h = h - ((h * PADDING_Y) / 100);
+  /* at zoom 1 the whole grid fits, in multiples of the textures size if possible */
+  int fit = SDL_min(max_w / (int)g->nb_cols, max_h / (int)g->nb_rows);
+  if (fit >= TEXTURES_SIZE) fit -= fit % TEXTURES_SIZE;
+  if (fit < MIN_SQUARE_SIZE) fit = MIN_SQUARE_SIZE;
+  double max_zoom = (double)SDL_max(fit, MAX_SQUARE_SIZE) / fit;
+  if (env->zoom < 1) env->zoom = 1;
+  if (env->zoom > max_zoom) env->zoom = max_zoom;
+  int size = fit * env->zoom;
+  env->square_size = size;
+
+  env->view.w = SDL_min(size * (int)g->nb_cols, max_w);
+  env->view.h = SDL_min(size * (int)g->nb_rows, max_h);
+  env->view.x = (w - env->view.w) / 2;
+  env->view.y = (h - env->view.h) / 2;
+  env->padding_w = w - env->view.w;
+  env->padding_h = h - env->view.h;
+
+  double max_x = g->nb_cols - (double)env->view.w / size;
+  double max_y = g->nb_rows - (double)env->view.h / size;
+  env->cam_x = env->cam_x > max_x ? max_x : env->cam_x < 0 ? 0 : env->cam_x;
+  env->cam_y = env->cam_y > max_y ? max_y : env->cam_y < 0 ? 0 : env->cam_y;
+  int left = env->cam_x * size;  // in pixels from the top left corner of the grid
+  int top = env->cam_y * size;
+  env->origin_x = env->view.x - left;
+  env->origin_y = env->view.y - top;
+  env->col0 = left / size;
+  env->row0 = top / size;
+  env->col1 = SDL_min(g->nb_cols, (uint)(left + env->view.w + size - 1) / size);
+  env->row1 = SDL_min(g->nb_rows, (uint)(top + env->view.h + size - 1) / size);
+}
+
+void _zoom_at(Env* env, int w, int h, double factor, int x, int y)
+{
+  _camera(env, w, h);
+  double u = env->cam_x + (double)(x - env->view.x) / env->square_size;  // square under (x, y)
+  double v = env->cam_y + (double)(y - env->view.y) / env->square_size;
+  env->zoom *= factor;
+  _camera(env, w, h);
+  env->cam_x = u - (double)(x - env->view.x) / env->square_size;
+  env->cam_y = v - (double)(y - env->view.y) / env->square_size;
+  _camera(env, w, h);
+  env->redraw = true;
+}
+
+void _pan(Env* env, int w, int h, int dx, int dy)
+{
+  env->cam_x -= (double)dx / env->square_size;
+  env->cam_y -= (double)dy / env->square_size;
+  _camera(env, w, h);
+  env->redraw = true;
+}
+
+int _load_assets(void* data)
+{
+  Env* env = data;
+  Assets* assets = &env->assets;
+  /* every image but the background is packed into the atlas, so that the
+   * grid and the buttons are drawn from a single texture */
+  SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_W, ATLAS_H, 32, SDL_PIXELFORMAT_RGBA32);
+  if (!atlas) ERROR("SDL_CreateRGBSurfaceWithFormat: %s\n", SDL_GetError());
+  for (int i = 0; i < TEXTURE_COUNT + BUTTON_COUNT; i++) {
+    SDL_Surface* surf = IMG_Load(_textures_names[i]);
+    if (!surf) ERROR("IMG_Load: %s : %s\n", _textures_names[i], SDL_GetError());
+    if (i == TEXTURE_BACKGROUND) {
+      assets->background = surf;
+      continue;
+    }
+    _atlas_put(atlas, i, surf);
+    SDL_FreeSurface(surf);
+  }
+
+  /* the digits of the walls go to the atlas too, the winning text is only
+   * rendered on first use */
+  SDL_Color color_black = {0, 0, 0, 0};
+  TTF_Font* font_arial = TTF_OpenFont(FONT, FONTSIZE);
+  if (!font_arial) ERROR("TTF_OpenFont: %s\n", FONT);
+  assets->font_mc = TTF_OpenFont(FONT_MC, FONTSIZE);
+  if (!assets->font_mc) ERROR("TTF_OpenFont: %s\n", FONT_MC);
+  assets->hud_font = TTF_OpenFont(FONT, HUD_FONTSIZE);
+  if (!assets->hud_font) ERROR("TTF_OpenFont: %s\n", FONT);
+  TTF_SetFontStyle(font_arial, TTF_STYLE_BOLD);
+  for (int i = TEXT_0; i <= TEXT_4; i++) {
+    SDL_Surface* surf = TTF_RenderText_Blended(font_arial, _texts_strings[i], color_black);
+    if (!surf) ERROR("TTF_RenderText_Blended: %s\n", SDL_GetError());
+    _atlas_put(atlas, TILE_TEXT(i), surf);
+    SDL_FreeSurface(surf);
+  }
+  TTF_CloseFont(font_arial);
+  assets->title = TTF_RenderText_Blended(assets->font_mc, _texts_strings[TEXT_TITLE], color_black);
+  if (!assets->title) ERROR("TTF_RenderText_Blended: %s\n", SDL_GetError());
+  SDL_Rect solid = _tile_rect(TILE_SOLID);
+  SDL_FillRect(atlas, &solid, SDL_MapRGBA(atlas->format, 0, 0, 0, 0xFF));
+  assets->atlas = atlas;
+  SDL_AtomicSet(&env->loaded, 1);
+  return 0;
+}
+
+bool _upload_assets(SDL_Renderer* ren, Env* env, bool wait)
+{
+  if (!wait && !SDL_AtomicGet(&env->loaded)) return false;
+  SDL_WaitThread(env->loader, NULL);
+  env->loader = NULL;
+  Assets* assets = &env->assets;
+  env->atlas = SDL_CreateTextureFromSurface(ren, assets->atlas);
+  if (!env->atlas) ERROR("SDL_CreateTextureFromSurface: %s\n", SDL_GetError());
+  SDL_SetTextureBlendMode(env->atlas, SDL_BLENDMODE_BLEND);
+  env->background = SDL_CreateTextureFromSurface(ren, assets->background);
+  env->texts[TEXT_TITLE] = SDL_CreateTextureFromSurface(ren, assets->title);
+  if (!env->background || !env->texts[TEXT_TITLE]) ERROR("SDL_CreateTextureFromSurface: %s\n", SDL_GetError());
+  SDL_FreeSurface(assets->atlas);
+  SDL_FreeSurface(assets->background);
+  SDL_FreeSurface(assets->title);
+  env->loading = false;
+  env->animating = false;
+  _startup_mark(env, "assets uploaded");
+  return true;
+}
+
+void _startup_mark(Env* env, const char* what)
+{
+  if (env->startup_log) PRINT("startup: %s at %u ms\n", what, SDL_GetTicks());
+}
+
+double _ms_since(Uint64 start)
+{
+  return 1e3 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+}
+
+void _engine_done(Env* env, const char* name, Uint64 start)
+{
+  env->engine_ms = _ms_since(start);
+  env->engine_call = name;
+  env->engine_logged = false;
+}
+
+void _hud_frame(Env* env, double process_ms, double render_ms, double frame_ms)
+{
+  uint k = env->nb_frames % HUD_FRAMES;
+  env->frame_ms[k] = frame_ms;
+  env->frame_ticks[k] = SDL_GetTicks();
+  env->render_ms = render_ms;
+  env->process_ms = process_ms;
+  if (env->csv) {
+    fprintf(env->csv, "%u,%u,%.3f,%.3f,%.3f,%u,", env->nb_frames, env->frame_ticks[k], process_ms, render_ms, frame_ms,
+            env->draw_calls);
+    if (!env->engine_logged)
+      fprintf(env->csv, "%s,%.3f\n", env->engine_call, env->engine_ms);
+    else
+      fprintf(env->csv, ",\n");
+  }
+  env->engine_logged = true;
+  env->nb_frames++;
+}
+
+/* renders a line of text of the overlay, returns its height */
+static int _hud_line(SDL_Renderer* ren, TTF_Font* font, const char* text, int x, int y)
+{
+  SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+  SDL_Surface* surf = TTF_RenderText_Blended(font, text, white);
+  if (!surf) return 0;
+  SDL_Texture* texture = SDL_CreateTextureFromSurface(ren, surf);
+  SDL_Rect rect = {x, y, surf->w, surf->h};
+  SDL_FreeSurface(surf);
+  if (!texture) return 0;
+  SDL_RenderCopy(ren, texture, NULL, &rect);
+  SDL_DestroyTexture(texture);
+  return rect.h;
+}
+
+void _hud_render(SDL_Window* win, Env* env, SDL_Renderer* ren)
+{
+  int w, h;
+  SDL_GetWindowSize(win, &w, &h);
+  /* statistics of the rolling window */
+  uint nb = env->nb_frames < HUD_FRAMES ? env->nb_frames : HUD_FRAMES;
+  uint buckets[HUD_BUCKETS] = {0}, fps = 0, max_bucket = 1;
+  double mean = 0, worst = 0;
+  Uint32 now = SDL_GetTicks();
+  for (uint k = 0; k < nb; k++) {
+    double ms = env->frame_ms[k];
+    uint b = ms / HUD_BUCKET_MS;
+    buckets[b < HUD_BUCKETS ? b : HUD_BUCKETS - 1]++;
+    mean += ms / nb;
+    if (ms > worst) worst = ms;
+    if (now - env->frame_ticks[k] < 1000) fps++;  // frames of the last second
+  }
+  for (uint b = 0; b < HUD_BUCKETS; b++)
+    if (buckets[b] > max_bucket) max_bucket = buckets[b];
+
+  SDL_Rect panel = {5, 5, 330, 170};
+  SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_BLEND);
+  SDL_SetRenderDrawColor(ren, 0, 0, 0, 0xA0);
+  SDL_RenderFillRect(ren, &panel);
+
+  char line[128];
+  int x = panel.x + 5, y = panel.y + 5;
+  snprintf(line, sizeof(line), "%u fps, frame %.2f ms (mean %.2f, worst %.2f)", fps,
+           nb ? env->frame_ms[(env->nb_frames - 1) % HUD_FRAMES] : 0.0, mean, worst);
+  y += _hud_line(ren, env->assets.hud_font, line, x, y);
+  snprintf(line, sizeof(line), "render %.2f ms, process %.2f ms, %u draw calls", env->render_ms, env->process_ms,
+           env->draw_calls);
+  y += _hud_line(ren, env->assets.hud_font, line, x, y);
+  if (env->engine_call)
+    snprintf(line, sizeof(line), "%s %.3f ms", env->engine_call, env->engine_ms);
+  else
+    snprintf(line, sizeof(line), "no engine call yet");
+  y += _hud_line(ren, env->assets.hud_font, line, x, y);
+
+  /* histogram of the frame times, by HUD_BUCKET_MS ms */
+  int bar_w = (panel.w - 10) / HUD_BUCKETS;
+  int graph_h = panel.y + panel.h - 5 - (y + 5);
+  SDL_SetRenderDrawColor(ren, 0x40, 0xE0, 0x40, 0xFF);
+  for (uint b = 0; b < HUD_BUCKETS; b++) {
+    int bar_h = graph_h * buckets[b] / max_bucket;
+    SDL_Rect bar = {x + b * bar_w, panel.y + panel.h - 5 - bar_h, bar_w - 1, bar_h};
+    SDL_RenderFillRect(ren, &bar);
+  }
 }
 
 void _bar_render(SDL_Window* win, Env* env, SDL_Renderer* ren)
 {
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
-  int grid_size = env->scale * TEXTURES_SIZE * env->g->nb_cols;
+  int grid_size = env->view.w;
   int button_size = grid_size / BUTTON_COUNT;
   button_size = button_size - button_size % TEXTURES_SIZE;
   int padding_bar = grid_size - (button_size * BUTTON_COUNT);
@@ -364,8 +786,9 @@ void _bar_render(SDL_Window* win, Env* env, SDL_Renderer* ren)
   for (uint i = 0; i < BUTTON_COUNT; i++) {
     int x = (env->padding_w / 2 + (padding_bar / 2)) + i * TEXTURES_SIZE * bar_scale;
     int y = (h - (env->padding_h / 2));
-    _render_texture(ren, env->textures[TEXTURE_COUNT + i], TEXTURES_SIZE * bar_scale, TEXTURES_SIZE * bar_scale, x, y);
+    _batch_tile(env, TEXTURE_COUNT + i, x, y, TEXTURES_SIZE * bar_scale);
   }
+  _batch_flush(ren, env);
 }
 
 void _render_text(SDL_Renderer* ren, SDL_Texture* text_texture, int w, int h, int x, int y)
@@ -382,7 +805,15 @@ void _render_game_win(SDL_Window* win, Env* env, SDL_Renderer* ren)
 {
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
+  if (!env->texts[TEXT_WINNING]) {  // rarely needed: rendered on first use
+    SDL_Color color_gray = {204, 201, 221, 0};
+    SDL_Surface* surf = TTF_RenderText_Blended(env->assets.font_mc, _texts_strings[TEXT_WINNING], color_gray);
+    if (!surf) ERROR("TTF_RenderText_Blended: %s\n", SDL_GetError());
+    env->texts[TEXT_WINNING] = SDL_CreateTextureFromSurface(ren, surf);
+    SDL_FreeSurface(surf);
+  }
   _render_text(ren, env->texts[TEXT_WINNING], (w - ((w * PADDING_X) / 100)), h / 10, w / 2, h / 2 - 10);
+  env->draw_calls++;
 }
 
 void _title_render(SDL_Window* win, Env* env, SDL_Renderer* ren)
@@ -390,6 +821,7 @@ void _title_render(SDL_Window* win, Env* env, SDL_Renderer* ren)
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
   _render_text(ren, env->texts[TEXT_TITLE], (w - ((w * PADDING_X) / 100)), (h * (PADDING_Y / 2)) / 100, w / 2, 5);
+  env->draw_calls++;
 }
 
 // void _reserve_audio(Env* env)
@@ -0,0 +1,75 @@
+/**
+ * @file bench_load.c
+ * @brief Benchmark of game_load() on a large save file.
+ * @details Usage: bench_load [size] [runs], saves a random size x size game
+ * (2000 x 2000 by default) in text and in binary, and reports the best and
+ * mean load times. The game_update_flags() call that ends a load is also timed
+ * alone, so that the cost of the parser itself can be told apart.
+ **/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_tools.h"
+
+#define BENCH_FILE "bench_load.txt"
+#define BENCH_BINARY_FILE "bench_load.bin"
+
+/* best load time of a file over some runs, or -1 if it does not load g back */
+static double _bench(cgame g, char* filename, uint runs, double* mean)
+{
+  double best = 0, total = 0;
+  for (uint k = 0; k < runs; k++) {
+    clock_t start = clock();
+    game loaded = game_load(filename);
+    double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (!loaded || !game_equal(g, loaded)) return -1;
+    game_delete(loaded);
+    total += t;
+    if (k == 0 || t < best) best = t;
+  }
+  *mean = total / runs;
+  return best;
+}
+
+int main(int argc, char* argv[])
+{
+  uint size = (argc > 1) ? (uint)atoi(argv[1]) : 2000;
+  uint runs = (argc > 2) ? (uint)atoi(argv[2]) : 10;
+  if (size == 0 || runs == 0) {
+    fprintf(stderr, "Usage: %s [size] [runs]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  game g = game_random_seeded(size, size, false, size * size / 5, true, 1);
+  double mb = (size * (size + 1.0) + 16) / 1e6;
+
+  double flags = 0;
+  for (uint k = 0; k < runs; k++) {
+    clock_t start = clock();
+    game_update_flags(g);
+    double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (k == 0 || t < flags) flags = t;
+  }
+
+  double mean = 0, mean_bin = 0;
+  double best = game_save(g, BENCH_FILE) ? _bench(g, BENCH_FILE, runs, &mean) : -1;
+  double best_bin = game_save_binary(g, BENCH_BINARY_FILE, false) ? _bench(g, BENCH_BINARY_FILE, runs, &mean_bin) : -1;
+  remove(BENCH_FILE);
+  remove(BENCH_BINARY_FILE);
+  game_delete(g);
+  if (best < 0 || best_bin < 0) {
+    fprintf(stderr, "bench_load: the loaded game differs from the saved one\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("game_load text %ux%u (%.1f MB): best %.1f ms, mean %.1f ms\n", size, size, mb, best * 1e3, mean * 1e3);
+  printf("game_load binary (%.1f MB): best %.1f ms, mean %.1f ms\n", size * (double)size / 2e6, best_bin * 1e3,
+         mean_bin * 1e3);
+  printf("game_update_flags alone: best %.1f ms\n", flags * 1e3);
+  return EXIT_SUCCESS;
+}
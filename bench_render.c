@@ -0,0 +1,111 @@
+/**
+ * @file bench_render.c
+ * @brief Headless benchmark of render() in graphics.c.
+ * @details Usage: bench_render [frames], runs init() and render() with SDL's
+ * dummy video driver and a software renderer drawing into an offscreen surface,
+ * so that no display nor GPU is needed. Random boards from 7 x 7 to 200 x 200
+ * are rendered blank, half lit and solved, and for each of them the first frame
+ * (every visible square is drawn), the idle frames (nothing changed) and the
+ * frames following a move are timed, with their draw calls. It must be run from
+ * the build directory, where the textures and the fonts are copied.
+ **/
+
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "graphics.h"
+
+#define BENCH_FILE "bench_render.txt"
+
+static const uint sizes[] = {7, 25, 50, 100, 200};
+static const char* states[] = {"blank", "half lit", "solved"};
+
+/* a size x size board in a given state: 0 blank, 1 half lit, 2 solved */
+static game _board(uint size, int state)
+{
+  game g = game_random_seeded(size, size, false, size * size / 5, true, size);
+  if (state == 0) game_restart(g);
+  if (state == 1) {  // the lightbulbs of the second half of the rows are removed
+    for (uint i = size / 2; i < size; i++)
+      for (uint j = 0; j < size; j++)
+        if (game_is_lightbulb(g, i, j)) game_set_square(g, i, j, S_BLANK);
+    game_update_flags(g);
+  }
+  return g;
+}
+
+/* renders a frame, returns its time in ms */
+static double _frame(SDL_Window* win, SDL_Renderer* ren, Env* env)
+{
+  Uint64 start = SDL_GetPerformanceCounter();
+  render(win, ren, env);
+  SDL_RenderPresent(ren);
+  return _ms_since(start);
+}
+
+int main(int argc, char* argv[])
+{
+  uint frames = (argc > 1) ? (uint)atoi(argv[1]) : 50;
+  if (frames == 0) {
+    fprintf(stderr, "Usage: %s [frames]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+  if (SDL_Init(SDL_INIT_VIDEO) != 0) ERROR("Error: SDL_Init VIDEO (%s)\n", SDL_GetError());
+  if (TTF_Init() != 0) ERROR("Error: TTF_Init (%s)\n", SDL_GetError());
+
+  printf("%-9s %-8s %10s %6s %10s %6s %10s %6s\n", "board", "state", "first ms", "calls", "idle ms", "calls", "move ms",
+         "calls");
+  for (uint s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for (int state = 0; state < 3; state++) {
+      /* init() loads the board from a file, as game_sdl does */
+      game g = _board(sizes[s], state);
+      bool saved = game_save(g, BENCH_FILE);
+      game_delete(g);
+      if (!saved) ERROR("Error: cannot save %s\n", BENCH_FILE);
+
+      SDL_Window* win = SDL_CreateWindow(APP_NAME, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_HIDDEN);
+      SDL_Surface* surf = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_RGBA32);
+      if (!win || !surf) ERROR("Error: SDL_CreateWindow (%s)\n", SDL_GetError());
+      SDL_Renderer* ren = SDL_CreateSoftwareRenderer(surf);
+      if (!ren) ERROR("Error: SDL_CreateSoftwareRenderer (%s)\n", SDL_GetError());
+      char* init_argv[] = {argv[0], BENCH_FILE};
+      Env* env = init(win, ren, 2, init_argv);
+      _upload_assets(ren, env, true);
+
+      double first = _frame(win, ren, env);
+      uint first_calls = env->draw_calls;
+
+      double idle = 0;
+      for (uint k = 0; k < frames; k++) idle += _frame(win, ren, env) / frames;
+      uint idle_calls = env->draw_calls;
+
+      /* a lightbulb is put and removed on a visible square between frames */
+      uint i = env->row0, j = env->col0;
+      while (j < env->col1 && game_is_black(env->g, i, j)) j++;
+      double move = 0;
+      uint move_calls = 0;
+      for (uint k = 0; k < frames && j < env->col1; k++) {
+        square next = game_is_lightbulb(env->g, i, j) ? S_BLANK : S_LIGHTBULB;
+        game_play_move(env->g, i, j, next);
+        move += _frame(win, ren, env) / frames;
+        move_calls = env->draw_calls;
+      }
+
+      char board[16];
+      snprintf(board, sizeof(board), "%ux%u", sizes[s], sizes[s]);
+      printf("%-9s %-8s %10.3f %6u %10.3f %6u %10.3f %6u\n", board, states[state], first, first_calls, idle,
+             idle_calls, move, move_calls);
+      clean(win, ren, env);  // also destroys the renderer and the window
+      SDL_FreeSurface(surf);
+    }
+  }
+  remove(BENCH_FILE);
+  TTF_Quit();
+  SDL_Quit();
+  return EXIT_SUCCESS;
+}
@@ -9,8 +9,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "game_ext.h"
+#include "game_journal.h"
 #include "game_private.h"
 #include "queue.h"
 
@@ -102,6 +104,104 @@ static bool _check_blackwall_error(cgame g, uint i, uint j)
   return true;
 }
 
+/* ************************************************************************** */
+
+/* calls update() on (i,j) and on the squares a lightbulb at (i,j) would light */
+static void _update_segments(game g, uint i, uint j, void (*update)(game g, uint i, uint j))
+{
+  update(g, i, j);
+  uint dim = MAX(g->nb_rows, g->nb_cols);
+  for (uint dir = UP; dir <= RIGHT; dir++) {
+    int ii = i;
+    int jj = j;
+    for (uint k = 1; k < dim; k++) {
+      if (!_next(g, &ii, &jj, dir)) break;
+      if (STATE(g, ii, jj) & S_BLACK) break;
+      update(g, ii, jj);
+    }
+  }
+}
+
+/* ************************************************************************** */
+
+static void _update_lighted_flag(game g, uint i, uint j)
+{
+  // lighted by itself, or by a lightbulb of its row or column segments
+  bool lighted = STATE(g, i, j) == S_LIGHTBULB || !_check_lightbulb_error(g, i, j);
+  SQUARE(g, i, j) = lighted ? (SQUARE(g, i, j) | F_LIGHTED) : (SQUARE(g, i, j) & ~F_LIGHTED);
+}
+
+/* ************************************************************************** */
+
+static void _update_lightbulb_error_flag(game g, uint i, uint j)
+{
+  bool error = STATE(g, i, j) == S_LIGHTBULB && !_check_lightbulb_error(g, i, j);
+  SQUARE(g, i, j) = error ? (SQUARE(g, i, j) | F_ERROR) : (SQUARE(g, i, j) & ~F_ERROR);
+}
+
+/* ************************************************************************** */
+
+/* error flags of the walls next to (i,j), which depend on its state and lighted flag */
+static void _update_blackwall_error_flags(game g, uint i, uint j)
+{
+  for (uint dir = UP; dir <= RIGHT; dir++) {
+    int ii = i;
+    int jj = j;
+    if (!_next(g, &ii, &jj, dir) || !(STATE(g, ii, jj) & S_BLACK)) continue;
+    bool error = !_check_blackwall_error(g, ii, jj);
+    SQUARE(g, ii, jj) = error ? (SQUARE(g, ii, jj) | F_ERROR) : (SQUARE(g, ii, jj) & ~F_ERROR);
+  }
+}
+
+/* ************************************************************************** */
+
+void _update_flags_at(game g, uint i, uint j, square old)
+{
+  assert(g);
+  assert(i < g->nb_rows);
+  assert(j < g->nb_cols);
+  if (g->stale) {
+    game_update_flags(g);
+    return;
+  }
+  square s = STATE(g, i, j);
+  assert(!(s & S_BLACK) && !(old & S_BLACK));
+
+  // 1) lighted flags: a new lightbulb only adds light, a removed one may leave its segments unlit
+  if (s == S_LIGHTBULB && old != S_LIGHTBULB) _update_lighted_flags(g, i, j);
+  if (old == S_LIGHTBULB && s != S_LIGHTBULB) _update_segments(g, i, j, _update_lighted_flag);
+
+  // 2) error flags of the lightbulbs which see (i,j), then of the walls around the squares updated
+  _update_segments(g, i, j, _update_lightbulb_error_flag);
+  _update_segments(g, i, j, _update_blackwall_error_flags);
+}
+
+/* ************************************************************************** */
+
+bool _oracle_check(cgame g, const char* call)
+{
+  assert(g);
+  game ref = game_copy(g);
+  game_update_flags(ref);
+  uint n = g->nb_rows * g->nb_cols;
+  bool same = memcmp(g->squares, ref->squares, n * sizeof(square)) == 0;
+  if (!same) {
+    fprintf(stderr, "oracle: %s diverges from game_update_flags on this %ux%u%s board:\n", call, g->nb_rows,
+            g->nb_cols, g->wrapping ? " wrapping" : "");
+    for (uint i = 0; i < g->nb_rows; i++) {
+      fprintf(stderr, "  ");
+      for (uint j = 0; j < g->nb_cols; j++) fputc(_square2str(SQUARE(ref, i, j)), stderr);
+      fputc('\n', stderr);
+    }
+    for (uint k = 0; k < n; k++)
+      if (g->squares[k] != ref->squares[k])
+        fprintf(stderr, "  (%u,%u): flags 0x%02x instead of 0x%02x\n", k / g->nb_cols, k % g->nb_cols,
+                g->squares[k] & F_MASK, ref->squares[k] & F_MASK);
+  }
+  game_delete(ref);
+  return same;
+}
+
 /* ************************************************************************** */
 /*                                 GAME BASIC                                 */
 /* ************************************************************************** */
@@ -129,10 +229,7 @@ bool game_equal(cgame g1, cgame g2)
   if (g1->nb_rows != g2->nb_rows) return false;
   if (g1->nb_cols != g2->nb_cols) return false;
 
-  for (uint i = 0; i < g1->nb_rows; i++)
-    for (uint j = 0; j < g1->nb_cols; j++) {
-      if (SQUARE(g1, i, j) != SQUARE(g2, i, j)) return false;
-    }
+  if (!_grid_equal(g1->squares, g2->squares, (size_t)g1->nb_rows * g1->nb_cols)) return false;
 
   if (g1->wrapping != g2->wrapping) return false;
 
@@ -143,6 +240,7 @@ bool game_equal(cgame g1, cgame g2)
 
 void game_delete(game g)
 {
+  game_journal_stop(g);
   free(g->squares);
   queue_free_full(g->undo_stack, free);
   queue_free_full(g->redo_stack, free);
@@ -157,6 +255,7 @@ void game_set_square(game g, uint i, uint j, square s)
   assert(i < g->nb_rows);
   assert(j < g->nb_cols);
   SQUARE(g, i, j) = s;
+  g->stale = true;  // the flags are only updated by game_update_flags()
 }
 
 /* ************************************************************************** */
@@ -196,8 +295,7 @@ void game_update_flags(game g)
   assert(g);
 
   // 0) reset all flags
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) SQUARE(g, i, j) = STATE(g, i, j);
+  _grid_clear_flags(g->squares, (size_t)g->nb_rows * g->nb_cols);
 
   // 1) update lighted flag
   for (uint i = 0; i < g->nb_rows; i++)
@@ -210,6 +308,7 @@ void game_update_flags(game g)
       if (game_is_lightbulb(g, i, j) && !_check_lightbulb_error(g, i, j)) SQUARE(g, i, j) |= F_ERROR;
       if (game_is_black(g, i, j) && !_check_blackwall_error(g, i, j)) SQUARE(g, i, j) |= F_ERROR;
     }
+  g->stale = false;
 }
 
 /* ************************************************************************** */
@@ -237,16 +336,18 @@ void game_play_move(game g, uint i, uint j, square s)
   bool black = game_is_black(g, i, j);
   black = black;
   assert(!black);
-  square cs = STATE(g, i, j);  // save current state
-  SQUARE(g, i, j) = s;         // update with new state
+  square cs = STATE(g, i, j);         // save current state
+  SQUARE(g, i, j) = s | FLAGS(g, i, j);  // update with new state
 
-  // update flags
-  game_update_flags(g);
+  // update flags of the squares the move can change
+  _update_flags_at(g, i, j, cs);
+  ORACLE_CHECK(g, "game_play_move");
 
   // save history
   _stack_clear(g->redo_stack);
   move m = {i, j, cs, s};
   _stack_push_move(g->undo_stack, m);
+  if (g->journal) _journal_log(g, J_PLAY, i, j, s);
 }
 
 /* ************************************************************************** */
@@ -255,16 +356,8 @@ bool game_is_over(cgame g)
 {
   assert(g);
 
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      // 1) check that square is lighted (except if it is a wall)
-      if (!game_is_black(g, i, j) && !game_is_lighted(g, i, j)) return false;
-
-      // 2) check if there are no errors
-      if (game_has_error(g, i, j)) return false;
-    }
-
-  return true;
+  // every square is lighted (except the walls), and there are no errors
+  return _grid_is_over(g->squares, (size_t)g->nb_rows * g->nb_cols);
 }
 
 /* ************************************************************************** */
@@ -273,18 +366,14 @@ void game_restart(game g)
 {
   assert(g);
 
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      square s = STATE(g, i, j);  // ignore flags
-      if (s & S_BLACK)            // keep only wall
-        SQUARE(g, i, j) = s;
-      else  // blank other
-        SQUARE(g, i, j) = S_BLANK;
-    }
+  // keep only walls, blank the other squares, then only walls can have an error
+  _grid_restart(g->squares, (size_t)g->nb_rows * g->nb_cols);
+  game_update_flags(g);
 
   // reset history
   _stack_clear(g->undo_stack);
   _stack_clear(g->redo_stack);
+  if (g->journal) _journal_log(g, J_RESTART, 0, 0, S_BLANK);
 }
 
 /* ************************************************************************** */
@@ -0,0 +1,378 @@
+/**
+ * @file game_bench.c
+ * @brief Benchmark suite of the engine.
+ * @details Every operation is timed on seeded random boards, from 7 x 7 to
+ * 500 x 500, with and without wrapping, so that two runs with the same seed
+ * measure the same workloads. An operation is first warmed up, and its batch
+ * (the number of calls per sample) is calibrated so that a sample lasts about
+ * a millisecond; then the samples are timed and reported as the median, the
+ * 99th percentile, the minimum and the mean time of a call. The results are
+ * written in JSON on standard output (or in a file with -o), and summed up in
+ * a table on standard error:
+ *
+ *     {"seed": 1, "warmup": 3, "repetitions": 20, "results": [
+ *       {"op": "play_move", "rows": 7, "cols": 7, "wrapping": false, "batch": 4096,
+ *        "samples": 20, "median_ns": 96.1, "p99_ns": 104.5, "min_ns": 95.0, "mean_ns": 97.2},
+ *       ...]}
+ *
+ * game_solve() is timed on the boards up to SOLVE_MAX_SIZE: its propagation
+ * solves a random 100 x 100 board in a few tens of ms, but the guesses left
+ * make the 500 x 500 ones too slow. The number of solutions of a random board
+ * grows exponentially with its size, so that game_nb_solutions() is only timed
+ * up to NB_SOLUTIONS_MAX_SIZE.
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime()
+
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_tools.h"
+
+#define BENCH_FILE "game_bench.txt"
+
+/* a sample lasts at least that long, if one call is shorter */
+#define SAMPLE_TIME 1e-3
+
+/* largest batch of calls in a sample */
+#define MAX_BATCH 100000
+
+/* largest boards (rows and columns) on which game_solve() and
+ * game_nb_solutions() are timed */
+#define SOLVE_MAX_SIZE 100
+#define NB_SOLUTIONS_MAX_SIZE 7
+
+static const uint sizes[] = {7, 25, 100, 500};
+
+/* ************************************************************************** */
+
+/* a board and the state needed by the operations timed on it */
+typedef struct {
+  uint size;
+  bool wrapping;
+  uint nb_walls;
+  uint64_t seed;
+  game solved;  // random game with its solution
+  game work;    // scratch game, modified by the operations
+  uint* cells;  // non wall squares (i * size + j), in a seeded order
+  uint nb_cells;
+  uint next;  // next cell to play
+  uint64_t nb_random;
+} workload;
+
+/* times a sample of batch calls of an operation, returns its duration in s */
+typedef double (*sample_fn)(workload* w, uint batch);
+
+typedef struct {
+  const char* name;
+  sample_fn sample;
+  uint max_size;  // largest board on which it is timed
+} operation;
+
+typedef struct {
+  uint warmup;
+  uint repetitions;
+  uint64_t seed;
+  const char* filter;  // NULL for all operations
+} options;
+
+/* ************************************************************************** */
+
+static double _now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+
+static void _workload_init(workload* w, uint size, bool wrapping, uint64_t seed)
+{
+  w->size = size;
+  w->wrapping = wrapping;
+  w->nb_walls = size * size / 5;
+  w->seed = seed;
+  w->solved = game_random_seeded(size, size, wrapping, w->nb_walls, true, seed);
+  w->work = game_copy(w->solved);
+  w->cells = malloc(size * size * sizeof(uint));
+  assert(w->solved && w->work && w->cells);
+  w->nb_cells = 0;
+  for (uint i = 0; i < size; i++)
+    for (uint j = 0; j < size; j++)
+      if (!game_is_black(w->solved, i, j)) w->cells[w->nb_cells++] = i * size + j;
+  // Fisher-Yates shuffle with a 64-bit LCG, so that moves spread over the board
+  uint64_t x = seed;
+  for (uint k = w->nb_cells; k > 1; k--) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint r = (uint)((x >> 33) % k);
+    uint tmp = w->cells[k - 1];
+    w->cells[k - 1] = w->cells[r];
+    w->cells[r] = tmp;
+  }
+  w->next = 0;
+  w->nb_random = 0;
+}
+
+static void _workload_free(workload* w)
+{
+  game_delete(w->solved);
+  game_delete(w->work);
+  free(w->cells);
+}
+
+/* toggles a lightbulb on the next cell of the work game */
+static void _play_next(workload* w)
+{
+  uint c = w->cells[w->next++ % w->nb_cells];
+  uint i = c / w->size, j = c % w->size;
+  game_play_move(w->work, i, j, game_is_lightbulb(w->work, i, j) ? S_BLANK : S_LIGHTBULB);
+}
+
+/* ************************************************************************** */
+/*                                OPERATIONS                                  */
+/* ************************************************************************** */
+
+static double _play_move(workload* w, uint batch)
+{
+  game_restart(w->work);  // the undo stack does not grow across samples
+  double start = _now();
+  for (uint k = 0; k < batch; k++) _play_next(w);
+  return _now() - start;
+}
+
+static double _undo(workload* w, uint batch)
+{
+  game_restart(w->work);
+  for (uint k = 0; k < batch; k++) _play_next(w);
+  double start = _now();
+  for (uint k = 0; k < batch; k++) game_undo(w->work);
+  return _now() - start;
+}
+
+static double _redo(workload* w, uint batch)
+{
+  game_restart(w->work);
+  for (uint k = 0; k < batch; k++) _play_next(w);
+  for (uint k = 0; k < batch; k++) game_undo(w->work);
+  double start = _now();
+  for (uint k = 0; k < batch; k++) game_redo(w->work);
+  return _now() - start;
+}
+
+static double _update_flags(workload* w, uint batch)
+{
+  double start = _now();
+  for (uint k = 0; k < batch; k++) game_update_flags(w->solved);
+  return _now() - start;
+}
+
+/* on a solved game, which is scanned up to its last square */
+static double _is_over(workload* w, uint batch)
+{
+  uint nb_over = 0;
+  double start = _now();
+  for (uint k = 0; k < batch; k++) nb_over += game_is_over(w->solved);
+  double t = _now() - start;
+  assert(nb_over == batch);
+  (void)nb_over;
+  return t;
+}
+
+static double _copy(workload* w, uint batch)
+{
+  double start = _now();
+  for (uint k = 0; k < batch; k++) game_delete(game_copy(w->solved));
+  return _now() - start;
+}
+
+static double _save(workload* w, uint batch)
+{
+  double start = _now();
+  for (uint k = 0; k < batch; k++)
+    if (!game_save(w->solved, BENCH_FILE)) exit(EXIT_FAILURE);
+  return _now() - start;
+}
+
+static double _load(workload* w, uint batch)
+{
+  if (!game_save(w->solved, BENCH_FILE)) exit(EXIT_FAILURE);
+  double start = _now();
+  for (uint k = 0; k < batch; k++) {
+    game g = game_load(BENCH_FILE);
+    if (!g) exit(EXIT_FAILURE);
+    game_delete(g);
+  }
+  return _now() - start;
+}
+
+/* a different seed at each call: the same seed would time the same game */
+static double _random(workload* w, uint batch)
+{
+  double start = _now();
+  for (uint k = 0; k < batch; k++)
+    game_delete(game_random_seeded(w->size, w->size, w->wrapping, w->nb_walls, true, w->seed + ++w->nb_random));
+  return _now() - start;
+}
+
+/* from the walls of the solved game */
+static double _solve(workload* w, uint batch)
+{
+  double t = 0;
+  for (uint k = 0; k < batch; k++) {
+    game_restart(w->work);
+    double start = _now();
+    bool solved = game_solve(w->work);
+    t += _now() - start;
+    if (!solved) exit(EXIT_FAILURE);
+  }
+  return t;
+}
+
+static double _nb_solutions(workload* w, uint batch)
+{
+  game_restart(w->work);
+  double start = _now();
+  for (uint k = 0; k < batch; k++)
+    if (game_nb_solutions(w->work) == 0) exit(EXIT_FAILURE);
+  return _now() - start;
+}
+
+static const operation operations[] = {
+    {"play_move", _play_move, UINT_MAX},    {"undo", _undo, UINT_MAX},
+    {"redo", _redo, UINT_MAX},              {"update_flags", _update_flags, UINT_MAX},
+    {"is_over", _is_over, UINT_MAX},        {"copy", _copy, UINT_MAX},
+    {"save", _save, UINT_MAX},              {"load", _load, UINT_MAX},
+    {"random", _random, UINT_MAX},          {"solve", _solve, SOLVE_MAX_SIZE},
+    {"nb_solutions", _nb_solutions, NB_SOLUTIONS_MAX_SIZE},
+};
+
+/* ************************************************************************** */
+/*                                 STATISTICS                                 */
+/* ************************************************************************** */
+
+static int _compare(const void* a, const void* b)
+{
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* value of rank ceil(p * n) of n sorted values */
+static double _percentile(const double* sorted, uint n, double p)
+{
+  uint rank = (uint)(p * n + 0.999999);
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/* ************************************************************************** */
+
+/* times an operation on a workload, writes its JSON result */
+static void _bench(const options* opt, const operation* op, workload* w, FILE* out, bool first)
+{
+  // warmup, and calibration of the batch on the fastest call
+  double call = 0;
+  for (uint k = 0; k < opt->warmup || k == 0; k++) {
+    double t = op->sample(w, 1);
+    if (k == 0 || t < call) call = t;
+  }
+  uint batch = 1;
+  if (call < SAMPLE_TIME) batch = call > 0 ? (uint)(SAMPLE_TIME / call) : MAX_BATCH;
+  if (batch > MAX_BATCH) batch = MAX_BATCH;
+
+  double* ns = malloc(opt->repetitions * sizeof(double));
+  assert(ns);
+  double mean = 0;
+  for (uint r = 0; r < opt->repetitions; r++) {
+    ns[r] = op->sample(w, batch) * 1e9 / batch;
+    mean += ns[r] / opt->repetitions;
+  }
+  qsort(ns, opt->repetitions, sizeof(double), _compare);
+  double median = _percentile(ns, opt->repetitions, 0.5);
+  double p99 = _percentile(ns, opt->repetitions, 0.99);
+
+  fprintf(out,
+          "%s\n    {\"op\": \"%s\", \"rows\": %u, \"cols\": %u, \"wrapping\": %s, \"batch\": %u, \"samples\": %u, "
+          "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, \"mean_ns\": %.1f}",
+          first ? "" : ",", op->name, w->size, w->size, w->wrapping ? "true" : "false", batch, opt->repetitions,
+          median, p99, ns[0], mean);
+  fprintf(stderr, "%-13s %4ux%-4u %-5s %7u %14.1f %14.1f\n", op->name, w->size, w->size, w->wrapping ? "yes" : "no",
+          batch, median, p99);
+  free(ns);
+}
+
+/* ************************************************************************** */
+
+static void _usage(char* cmd)
+{
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  -r <repetitions>  timed samples per operation (default 20)\n"
+          "  -w <warmup>       untimed samples per operation (default 3)\n"
+          "  -s <seed>         seed of the boards (default 1)\n"
+          "  -f <op>           only time the operations whose name contains op\n"
+          "  -o <file>         write the JSON results to a file (default: standard output)\n",
+          cmd);
+  exit(EXIT_FAILURE);
+}
+
+/* ************************************************************************** */
+
+int main(int argc, char* argv[])
+{
+  options opt = {.warmup = 3, .repetitions = 20, .seed = 1};
+  char* output = NULL;
+  for (int a = 1; a < argc; a++) {
+    if (argv[a][0] != '-' || argv[a][1] == '\0' || argv[a][2] != '\0' || a + 1 >= argc) _usage(argv[0]);
+    char o = argv[a][1];
+    char* arg = argv[++a];
+    char* end;
+    unsigned long v = strtoul(arg, &end, 10);
+    bool number = (end != arg && *end == '\0');
+    if (o == 'r' && number && v > 0 && v <= 1000000) opt.repetitions = (uint)v;
+    else if (o == 'w' && number && v <= 1000000) opt.warmup = (uint)v;
+    else if (o == 's' && number) opt.seed = v;
+    else if (o == 'f') opt.filter = arg;
+    else if (o == 'o') output = arg;
+    else _usage(argv[0]);
+  }
+
+  FILE* out = output ? fopen(output, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "Cannot open %s\n", output);
+    return EXIT_FAILURE;
+  }
+  fprintf(out, "{\"seed\": %llu, \"warmup\": %u, \"repetitions\": %u, \"results\": [", (unsigned long long)opt.seed,
+          opt.warmup, opt.repetitions);
+  fprintf(stderr, "%-13s %9s %-5s %7s %14s %14s\n", "op", "board", "wrap", "batch", "median ns", "p99 ns");
+
+  bool first = true;
+  for (uint s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for (int wrapping = 0; wrapping < 2; wrapping++) {
+      workload w;
+      _workload_init(&w, sizes[s], wrapping, opt.seed);
+      for (uint o = 0; o < sizeof(operations) / sizeof(operations[0]); o++) {
+        const operation* op = &operations[o];
+        if (sizes[s] > op->max_size) continue;
+        if (opt.filter && !strstr(op->name, opt.filter)) continue;
+        _bench(&opt, op, &w, out, first);
+        first = false;
+      }
+      _workload_free(&w);
+    }
+
+  fprintf(out, "\n]}\n");
+  remove(BENCH_FILE);
+  if (output && fclose(out) != 0) {
+    fprintf(stderr, "Cannot write %s\n", output);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file game_corpus.c
+ * @brief Corpus of games, see game_corpus.h for the file layout.
+ * @copyright University of Bordeaux. All rights reserved, 2021.
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // fileno(), ftruncate(), mmap()
+
+#include "game_corpus.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_private.h"
+
+/* ************************************************************************** */
+/*                                  LAYOUT                                    */
+/* ************************************************************************** */
+
+/* file header:   0 "LUPC"   4 version   8 reserved
+ * record header: 0 "LUPR"   4 encoding  8 seed   16 nb_solutions   20 difficulty
+ *                24 size of the game    28 FNV-1a of bytes 0..27 and of the game
+ * footer:        the record offsets (8 bytes each), then
+ *                0 offset of the index  8 nb_records  16 "LUPI"  20 version */
+
+#define CORPUS_VERSION 1
+#define FILE_HEADER_SIZE 16
+#define RECORD_HEADER_SIZE 32
+#define FOOTER_SIZE 24
+
+enum { ENCODING_TEXT = 0, ENCODING_BINARY = 1 };
+
+struct corpus_s {
+  char* filename;
+  FILE* file;
+  bool writable;
+  bool dirty;                /* games appended since the index was written */
+  const unsigned char* map;  /* mapping of the first map_size bytes of the file */
+  size_t map_size;
+  uint64_t* offsets;         /* offset of each record */
+  uint nb_records;
+  uint capacity;
+  uint64_t data_end;         /* end of the last record */
+};
+
+struct corpus_reader_s {
+  char* filename;
+  FILE* file;
+  unsigned char* buf;
+  size_t capacity;
+  uint index;
+};
+
+/* ************************************************************************** */
+
+static void _put_u32(unsigned char* p, uint32_t v)
+{
+  for (uint k = 0; k < 4; k++) p[k] = (v >> (8 * k)) & 0xFF;
+}
+
+static void _put_u64(unsigned char* p, uint64_t v)
+{
+  for (uint k = 0; k < 8; k++) p[k] = (v >> (8 * k)) & 0xFF;
+}
+
+static uint32_t _get_u32(const unsigned char* p)
+{
+  return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t _get_u64(const unsigned char* p) { return _get_u32(p) | ((uint64_t)_get_u32(p + 4) << 32); }
+
+/* ************************************************************************** */
+
+static uint32_t _record_checksum(const unsigned char* header, const unsigned char* data, size_t size)
+{
+  return _fnv1a(_fnv1a(FNV1A_INIT, header, 28), data, size);
+}
+
+/* ************************************************************************** */
+
+/* decodes the game of a record whose header and data have been checked */
+static game _record_decode(const unsigned char* header, const unsigned char* data, const char* filename, uint i,
+                           corpus_meta* meta)
+{
+  char name[256];
+  snprintf(name, sizeof(name), "%s[%u]", filename, i);
+  uint32_t size = _get_u32(header + 24);
+  game g = NULL;
+  if (header[4] == ENCODING_TEXT)
+    g = _text_decode((const char*)data, size, name);
+  else if (header[4] == ENCODING_BINARY)
+    g = _binary_decode(data, size, name);
+  else
+    fprintf(stderr, "%s: unknown encoding\n", name);
+  if (g && meta) {
+    meta->seed = _get_u64(header + 8);
+    meta->nb_solutions = _get_u32(header + 16);
+    meta->difficulty = _get_u32(header + 20);
+  }
+  return g;
+}
+
+/* ************************************************************************** */
+
+/* size of the valid record at offset off of a buffer, 0 if there is none */
+static size_t _record_size(const unsigned char* buf, size_t size, uint64_t off)
+{
+  if (off > size || size - off < RECORD_HEADER_SIZE) return 0;
+  const unsigned char* header = buf + off;
+  if (memcmp(header, "LUPR", 4) != 0) return 0;
+  uint64_t data_size = _get_u32(header + 24);
+  if (data_size > size - off - RECORD_HEADER_SIZE) return 0;
+  if (_record_checksum(header, header + RECORD_HEADER_SIZE, data_size) != _get_u32(header + 28)) return 0;
+  return RECORD_HEADER_SIZE + data_size;
+}
+
+/* ************************************************************************** */
+/*                                  CORPUS                                    */
+/* ************************************************************************** */
+
+static bool _push_offset(corpus c, uint64_t off)
+{
+  if (c->nb_records == c->capacity) {
+    uint capacity = c->capacity ? 2 * c->capacity : 64;
+    uint64_t* offsets = realloc(c->offsets, capacity * sizeof(uint64_t));
+    if (offsets == NULL) return false;
+    c->offsets = offsets;
+    c->capacity = capacity;
+  }
+  c->offsets[c->nb_records++] = off;
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* maps the whole file again (after appends) */
+static bool _remap(corpus c)
+{
+  if (c->map) munmap((void*)c->map, c->map_size);
+  c->map = NULL;
+  c->map_size = 0;
+  struct stat st;
+  if ((c->writable && fflush(c->file) != 0) || fstat(fileno(c->file), &st) != 0) return false;
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(c->file), 0);
+  if (map == MAP_FAILED) return false;
+  c->map = map;
+  c->map_size = st.st_size;
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* reads the index from the footer, or rebuilds it by scanning the records */
+static bool _load_index(corpus c)
+{
+  const unsigned char* m = c->map;
+  size_t size = c->map_size;
+  if (size >= FILE_HEADER_SIZE + FOOTER_SIZE && memcmp(m + size - 8, "LUPI", 4) == 0) {
+    const unsigned char* footer = m + size - FOOTER_SIZE;
+    uint64_t index = _get_u64(footer), n = _get_u64(footer + 8);
+    if (index >= FILE_HEADER_SIZE && n <= (uint)-1 && index <= size - FOOTER_SIZE &&
+        n == (size - FOOTER_SIZE - index) / 8 && index + 8 * n + FOOTER_SIZE == size) {
+      for (uint64_t k = 0; k < n; k++)
+        if (!_push_offset(c, _get_u64(m + index + 8 * k))) return false;
+      c->data_end = index;
+      return true;
+    }
+  }
+  // no valid index: the records are self-delimited
+  uint64_t off = FILE_HEADER_SIZE;
+  size_t len;
+  while ((len = _record_size(m, size, off)) > 0) {
+    if (!_push_offset(c, off)) return false;
+    off += len;
+  }
+  c->data_end = off;
+  if (off != size) fprintf(stderr, "%s: no index, %u records recovered\n", c->filename, c->nb_records);
+  return true;
+}
+
+/* ************************************************************************** */
+
+corpus corpus_open(char* filename, bool writable)
+{
+  assert(filename);
+  corpus c = calloc(1, sizeof(struct corpus_s));
+  if (c == NULL) return NULL;
+  c->filename = strdup(filename);
+  c->writable = writable;
+  c->file = fopen(filename, writable ? "r+b" : "rb");
+  if (c->file == NULL && writable) {
+    c->file = fopen(filename, "w+b");
+    unsigned char header[FILE_HEADER_SIZE] = {'L', 'U', 'P', 'C', CORPUS_VERSION};
+    if (c->file && fwrite(header, 1, sizeof(header), c->file) != sizeof(header)) {
+      fclose(c->file);
+      c->file = NULL;
+    }
+  }
+  const char* error = NULL;
+  if (c->filename == NULL || c->file == NULL)
+    error = "cannot open the file";
+  else if (!_remap(c))
+    error = "cannot map the file";
+  else if (c->map_size < FILE_HEADER_SIZE || memcmp(c->map, "LUPC", 4) != 0)
+    error = "not a corpus file";
+  else if (c->map[4] != CORPUS_VERSION)
+    error = "unsupported version";
+  else if (!_load_index(c))
+    error = "out of memory";
+  if (error) {
+    fprintf(stderr, "%s: %s\n", filename, error);
+    if (c->file) fclose(c->file);
+    if (c->map) munmap((void*)c->map, c->map_size);
+    free(c->offsets);
+    free(c->filename);
+    free(c);
+    return NULL;
+  }
+  return c;
+}
+
+/* ************************************************************************** */
+
+uint corpus_size(corpus c)
+{
+  assert(c);
+  return c->nb_records;
+}
+
+/* ************************************************************************** */
+
+game corpus_get(corpus c, uint i, corpus_meta* meta)
+{
+  assert(c);
+  if (i >= c->nb_records) return NULL;
+  if (c->data_end > c->map_size && !_remap(c)) return NULL;  // appended since mapped
+  uint64_t off = c->offsets[i];
+  if (_record_size(c->map, c->data_end, off) == 0) {
+    fprintf(stderr, "%s[%u]: corrupted record\n", c->filename, i);
+    return NULL;
+  }
+  return _record_decode(c->map + off, c->map + off + RECORD_HEADER_SIZE, c->filename, i, meta);
+}
+
+/* ************************************************************************** */
+
+bool corpus_append(corpus c, cgame g, const corpus_meta* meta, bool binary)
+{
+  assert(c && g && meta);
+  if (!c->writable) return false;
+  // the old index is dropped first: a crash can not leave an index that misses records
+  if (!c->dirty && (fflush(c->file) != 0 || ftruncate(fileno(c->file), c->data_end) != 0)) return false;
+  c->dirty = true;
+
+  size_t size;
+  unsigned char* data = binary ? _binary_encode(g, true, &size) : (unsigned char*)_text_encode(g, &size);
+  if (data == NULL || size > (uint32_t)-1) {
+    free(data);
+    return false;
+  }
+  unsigned char header[RECORD_HEADER_SIZE] = {'L', 'U', 'P', 'R', binary ? ENCODING_BINARY : ENCODING_TEXT};
+  _put_u64(header + 8, meta->seed);
+  _put_u32(header + 16, meta->nb_solutions);
+  _put_u32(header + 20, meta->difficulty);
+  _put_u32(header + 24, size);
+  _put_u32(header + 28, _record_checksum(header, data, size));
+
+  bool ok = fseek(c->file, c->data_end, SEEK_SET) == 0 && fwrite(header, 1, RECORD_HEADER_SIZE, c->file) == RECORD_HEADER_SIZE &&
+            fwrite(data, 1, size, c->file) == size && _push_offset(c, c->data_end);
+  free(data);
+  if (ok) c->data_end += RECORD_HEADER_SIZE + size;
+  return ok;
+}
+
+/* ************************************************************************** */
+
+bool corpus_close(corpus c)
+{
+  assert(c);
+  bool ok = true;
+  if (c->dirty) {
+    unsigned char footer[FOOTER_SIZE] = {0};
+    _put_u64(footer, c->data_end);
+    _put_u64(footer + 8, c->nb_records);
+    memcpy(footer + 16, "LUPI", 4);
+    footer[20] = CORPUS_VERSION;
+    ok = fseek(c->file, c->data_end, SEEK_SET) == 0;
+    for (uint k = 0; k < c->nb_records && ok; k++) {
+      unsigned char off[8];
+      _put_u64(off, c->offsets[k]);
+      ok = fwrite(off, 1, 8, c->file) == 8;
+    }
+    ok = ok && fwrite(footer, 1, FOOTER_SIZE, c->file) == FOOTER_SIZE && fflush(c->file) == 0;
+    if (!ok) fprintf(stderr, "%s: cannot write the index\n", c->filename);
+  }
+  if (c->map) munmap((void*)c->map, c->map_size);
+  ok = (fclose(c->file) == 0) && ok;
+  free(c->offsets);
+  free(c->filename);
+  free(c);
+  return ok;
+}
+
+/* ************************************************************************** */
+/*                                  READER                                    */
+/* ************************************************************************** */
+
+corpus_reader corpus_reader_open(char* filename)
+{
+  assert(filename);
+  unsigned char header[FILE_HEADER_SIZE];
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL || fread(header, 1, FILE_HEADER_SIZE, file) != FILE_HEADER_SIZE ||
+      memcmp(header, "LUPC", 4) != 0 || header[4] != CORPUS_VERSION) {
+    fprintf(stderr, "%s: not a corpus file\n", filename);
+    if (file) fclose(file);
+    return NULL;
+  }
+  corpus_reader r = calloc(1, sizeof(struct corpus_reader_s));
+  if (r) r->filename = strdup(filename);
+  if (r == NULL || r->filename == NULL) {
+    free(r);
+    fclose(file);
+    return NULL;
+  }
+  r->file = file;
+  return r;
+}
+
+/* ************************************************************************** */
+
+game corpus_reader_next(corpus_reader r, corpus_meta* meta)
+{
+  assert(r);
+  unsigned char header[RECORD_HEADER_SIZE];
+  // the index, or the end of the file, follows the last record
+  if (fread(header, 1, RECORD_HEADER_SIZE, r->file) != RECORD_HEADER_SIZE || memcmp(header, "LUPR", 4) != 0)
+    return NULL;
+  size_t size = _get_u32(header + 24);
+  if (size > r->capacity) {
+    unsigned char* buf = realloc(r->buf, size);
+    if (buf == NULL) return NULL;
+    r->buf = buf;
+    r->capacity = size;
+  }
+  if (fread(r->buf, 1, size, r->file) != size || _record_checksum(header, r->buf, size) != _get_u32(header + 28)) {
+    fprintf(stderr, "%s[%u]: corrupted record\n", r->filename, r->index);
+    return NULL;
+  }
+  return _record_decode(header, r->buf, r->filename, r->index++, meta);
+}
+
+/* ************************************************************************** */
+
+void corpus_reader_close(corpus_reader r)
+{
+  if (r == NULL) return;
+  fclose(r->file);
+  free(r->buf);
+  free(r->filename);
+  free(r);
+}
@@ -0,0 +1,114 @@
+/**
+ * @file game_corpus.h
+ * @brief Corpus of games: many games in a single file, with random access.
+ * @details A corpus file starts with a 16-byte header ("LUPC", version), then
+ * holds an append-only stream of records. Each record is a 32-byte header (the
+ * seed, solution count and difficulty of the game, the encoding and size of
+ * the game, and a checksum) followed by the game itself, in the text format of
+ * @ref game_save or in the binary format of @ref game_save_binary. When the
+ * corpus is closed, an index of the record offsets is written at the end of
+ * the file, so that @ref corpus_get reaches any record in O(1) through a
+ * memory mapping. If the index is missing (the writer died), the records are
+ * scanned again on open, and an interrupted last record is dropped.
+ * @copyright University of Bordeaux. All rights reserved, 2021.
+ **/
+
+#ifndef __GAME_CORPUS_H__
+#define __GAME_CORPUS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+/**
+ * @brief Value of an unknown metadata (solution count or difficulty).
+ **/
+#define CORPUS_UNKNOWN ((uint)-1)
+
+/**
+ * @brief Metadata of a game of a corpus.
+ **/
+typedef struct {
+  uint64_t seed;     /**< seed the game has been generated from */
+  uint nb_solutions; /**< number of solutions, or CORPUS_UNKNOWN */
+  uint difficulty;   /**< number of guesses of the solver, or CORPUS_UNKNOWN */
+} corpus_meta;
+
+/**
+ * @brief The structure pointer that stores an open corpus.
+ **/
+typedef struct corpus_s* corpus;
+
+/**
+ * @brief The structure pointer that stores a streaming corpus reader.
+ **/
+typedef struct corpus_reader_s* corpus_reader;
+
+/**
+ * @brief Opens a corpus file.
+ * @param filename the corpus file
+ * @param writable if true, games can be appended, and the file is created if it
+ * does not exist
+ * @return the open corpus, or NULL on error (reported on stderr)
+ **/
+corpus corpus_open(char* filename, bool writable);
+
+/**
+ * @brief Returns the number of games of a corpus.
+ * @param c the corpus
+ * @return the number of games
+ **/
+uint corpus_size(corpus c);
+
+/**
+ * @brief Loads the i-th game of a corpus, in O(1).
+ * @param c the corpus
+ * @param i the index of the game, from 0
+ * @param meta if not NULL, receives the metadata of the game
+ * @return the game, or NULL if @p i is out of range or the record is corrupted
+ **/
+game corpus_get(corpus c, uint i, corpus_meta* meta);
+
+/**
+ * @brief Appends a game at the end of a corpus.
+ * @param c the corpus, opened as writable
+ * @param g the game
+ * @param meta the metadata of the game
+ * @param binary if true, the game is stored in the binary format (with RLE),
+ * otherwise in the text format
+ * @return true if the game has been appended, false otherwise
+ **/
+bool corpus_append(corpus c, cgame g, const corpus_meta* meta, bool binary);
+
+/**
+ * @brief Closes a corpus, and writes its index if games have been appended.
+ * @param c the corpus
+ * @return true if the index has been written (or was not needed), false otherwise
+ **/
+bool corpus_close(corpus c);
+
+/**
+ * @brief Opens a corpus file for a sequential reading.
+ * @details The reader does not use the index and only holds one record in
+ * memory: it can go through a corpus of any size.
+ * @param filename the corpus file
+ * @return the reader, or NULL on error (reported on stderr)
+ **/
+corpus_reader corpus_reader_open(char* filename);
+
+/**
+ * @brief Loads the next game of a corpus.
+ * @param r the reader
+ * @param meta if not NULL, receives the metadata of the game
+ * @return the game, or NULL at the end of the corpus (or on a corrupted record)
+ **/
+game corpus_reader_next(corpus_reader r, corpus_meta* meta);
+
+/**
+ * @brief Closes a corpus reader.
+ * @param r the reader
+ **/
+void corpus_reader_close(corpus_reader r);
+
+#endif  // __GAME_CORPUS_H__
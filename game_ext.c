@@ -28,6 +28,7 @@ game game_new_ext(uint nb_rows, uint nb_cols, square* squares, bool wrapping)
       square s = squares[i * nb_cols + j];
       SQUARE(g, i, j) = s;
     }
+  g->stale = true;  // the flags are the given ones
   return g;
 }
 
@@ -48,6 +49,8 @@ game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping)
   assert(g->undo_stack);
   g->redo_stack = queue_new();
   assert(g->redo_stack);
+  g->journal = NULL;
+  g->stale = false;  // blank squares, without flags
   return g;
 }
 
@@ -70,9 +73,12 @@ void game_undo(game g)
   assert(g);
   if (_stack_is_empty(g->undo_stack)) return;
   move m = _stack_pop_move(g->undo_stack);
-  game_set_square(g, m.i, m.j, m.old);
-  game_update_flags(g);
+  square cs = STATE(g, m.i, m.j);
+  SQUARE(g, m.i, m.j) = m.old | FLAGS(g, m.i, m.j);
+  _update_flags_at(g, m.i, m.j, cs);
+  ORACLE_CHECK(g, "game_undo");
   _stack_push_move(g->redo_stack, m);
+  if (g->journal) _journal_log(g, J_UNDO, 0, 0, S_BLANK);
 }
 
 /* ************************************************************************** */
@@ -82,9 +88,12 @@ void game_redo(game g)
   assert(g);
   if (_stack_is_empty(g->redo_stack)) return;
   move m = _stack_pop_move(g->redo_stack);
-  game_set_square(g, m.i, m.j, m.new);
-  game_update_flags(g);
+  square cs = STATE(g, m.i, m.j);
+  SQUARE(g, m.i, m.j) = m.new | FLAGS(g, m.i, m.j);
+  _update_flags_at(g, m.i, m.j, cs);
+  ORACLE_CHECK(g, "game_redo");
   _stack_push_move(g->undo_stack, m);
+  if (g->journal) _journal_log(g, J_REDO, 0, 0, S_BLANK);
 }
 
 /* ************************************************************************** */
@@ -0,0 +1,328 @@
+/**
+ * @file game_gen.c
+ * @brief Bulk generation of random games, across a pool of threads.
+ * @details Candidate k is generated from seed (base seed + k), so that every
+ * puzzle of a corpus can be generated again from its seed alone. Games are
+ * written in candidate order, hence the output does not depend on the number
+ * of threads. With -o, the games are appended to a corpus file (see
+ * game_corpus.h). Otherwise they are printed one per line after a comment
+ * header:
+ *
+ *     seed rows cols wrapping walls unique guesses grid
+ *
+ * where grid is the rows * cols squares in the game_save() characters,
+ * row-major, and guesses the number of branching points needed to solve it
+ * ('-' when neither -u nor -g asked for it).
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime(), sysconf()
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_corpus.h"
+#include "game_ext.h"
+#include "game_private.h"
+#include "game_tools.h"
+
+/* number of candidates which may be in progress ahead of the last one written */
+#define WINDOW_PER_THREAD 4
+
+/* the generation gives up after that many candidates per requested game */
+#define MAX_CANDIDATES_PER_GAME 1000
+
+/* ************************************************************************** */
+
+typedef struct {
+  uint nb_rows, nb_cols, nb_walls;
+  bool wrapping;
+  bool unique;
+  uint min_guesses, max_guesses;
+  uint64_t seed;
+  uint nb_games;
+  uint nb_threads;
+  corpus out;  // NULL for the standard output
+} options;
+
+typedef enum { DONE_ACCEPTED, DONE_NOT_UNIQUE, DONE_DIFFICULTY } outcome;
+
+typedef struct {
+  bool done;
+  outcome result;
+  uint nb_attempts;  // random solutions tried by game_random_unique, else 1
+  game g;            // only for accepted candidates
+  corpus_meta meta;
+} slot;
+
+typedef struct {
+  const options* opt;
+  pthread_mutex_t lock;
+  pthread_cond_t window_moved;
+  uint window;
+  slot* slots;             // slots[k % window] for candidate k
+  uint64_t next;           // next candidate to generate
+  uint64_t max_candidates;
+  uint64_t flushed;        // candidates [0, flushed) are written out
+  uint nb_accepted;
+  uint nb_rejected[3];     // indexed by outcome, the failed attempts of game_random_unique included
+  bool stop;
+  bool write_error;
+} generator;
+
+/* ************************************************************************** */
+
+/* generates candidate k, returns the game and its metadata when accepted */
+static outcome _generate(const options* opt, uint64_t k, game* result, corpus_meta* meta, uint* nb_attempts)
+{
+  uint64_t seed = opt->seed + k;
+  game g;
+  *nb_attempts = 1;
+  if (opt->unique) {
+    g = game_random_unique(opt->nb_rows, opt->nb_cols, opt->wrapping, opt->nb_walls, seed, nb_attempts);
+    if (!g) return DONE_NOT_UNIQUE;
+  } else {
+    g = game_random_seeded(opt->nb_rows, opt->nb_cols, opt->wrapping, opt->nb_walls, false, seed);
+  }
+  // the difficulty costs a full search: it is only measured when it is needed
+  bool rated = opt->unique || opt->min_guesses > 0 || opt->max_guesses != (uint)-1;
+  uint guesses = 0;
+  if (rated) _solve_count(g, opt->unique ? 2 : 1, (uint)-1, NULL, &guesses);
+  if (guesses < opt->min_guesses || guesses > opt->max_guesses) {
+    game_delete(g);
+    return DONE_DIFFICULTY;
+  }
+  meta->seed = seed;
+  meta->nb_solutions = opt->unique ? 1 : CORPUS_UNKNOWN;
+  meta->difficulty = rated ? guesses : CORPUS_UNKNOWN;
+  *result = g;
+  return DONE_ACCEPTED;
+}
+
+/* ************************************************************************** */
+
+static const char square_chars[] = {
+    [S_BLANK] = 'b', [S_LIGHTBULB] = '*', [S_MARK] = '-', [S_BLACK0] = '0', [S_BLACK1] = '1',
+    [S_BLACK2] = '2', [S_BLACK3] = '3',   [S_BLACK4] = '4', [S_BLACKU] = 'w'};
+
+static bool _print(const options* opt, cgame g, const corpus_meta* meta)
+{
+  printf("%llu %u %u %d %u %d ", (unsigned long long)meta->seed, opt->nb_rows, opt->nb_cols, opt->wrapping,
+         opt->nb_walls, opt->unique);
+  if (meta->difficulty == CORPUS_UNKNOWN)
+    printf("- ");
+  else
+    printf("%u ", meta->difficulty);
+  for (uint i = 0; i < opt->nb_rows; i++)
+    for (uint j = 0; j < opt->nb_cols; j++) putchar(square_chars[game_get_state(g, i, j)]);
+  return putchar('\n') != EOF;
+}
+
+/* ************************************************************************** */
+
+/* writes out the finished candidates at the head of the window, in order */
+static void _flush(generator* gen)
+{
+  const options* opt = gen->opt;
+  for (;;) {
+    slot* sl = &gen->slots[gen->flushed % gen->window];
+    if (!sl->done) return;
+    if (!gen->stop) {
+      // the attempts before the last one had no unique solution
+      gen->nb_rejected[DONE_NOT_UNIQUE] += sl->nb_attempts - 1;
+      if (sl->result == DONE_ACCEPTED) {
+        bool ok = opt->out ? corpus_append(opt->out, sl->g, &sl->meta, true) : _print(opt, sl->g, &sl->meta);
+        if (!ok) gen->write_error = gen->stop = true;
+        if (ok && ++gen->nb_accepted == opt->nb_games) gen->stop = true;
+      } else {
+        gen->nb_rejected[sl->result]++;
+      }
+    }
+    if (sl->g) game_delete(sl->g);
+    sl->g = NULL;
+    sl->done = false;
+    gen->flushed++;
+    pthread_cond_broadcast(&gen->window_moved);
+  }
+}
+
+/* ************************************************************************** */
+
+static void* _worker(void* arg)
+{
+  generator* gen = arg;
+  pthread_mutex_lock(&gen->lock);
+  for (;;) {
+    while (!gen->stop && gen->next >= gen->flushed + gen->window) pthread_cond_wait(&gen->window_moved, &gen->lock);
+    if (gen->stop || gen->next >= gen->max_candidates) break;
+    uint64_t k = gen->next++;
+    pthread_mutex_unlock(&gen->lock);
+
+    game g = NULL;
+    corpus_meta meta;
+    uint nb_attempts;
+    outcome result = _generate(gen->opt, k, &g, &meta, &nb_attempts);
+
+    pthread_mutex_lock(&gen->lock);
+    slot* sl = &gen->slots[k % gen->window];
+    sl->done = true;
+    sl->result = result;
+    sl->nb_attempts = nb_attempts;
+    sl->g = g;
+    sl->meta = meta;
+    _flush(gen);
+  }
+  pthread_mutex_unlock(&gen->lock);
+  return NULL;
+}
+
+/* ************************************************************************** */
+
+static double _now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+
+static void _usage(char* cmd)
+{
+  fprintf(stderr,
+          "Usage: %s [options] <nb_games>\n"
+          "  -r <rows>       number of rows (default 7)\n"
+          "  -c <cols>       number of columns (default 7)\n"
+          "  -d <percent>    wall density, in percent of the squares (default 20)\n"
+          "  -w              wrapping games\n"
+          "  -u              only games with a unique solution\n"
+          "  -g <min>:<max>  only games solved with min to max guesses\n"
+          "  -s <seed>       seed of the first candidate (default 0)\n"
+          "  -j <threads>    number of threads (default: number of cpus)\n"
+          "  -o <file>       append the games to a corpus file (default: one per line on standard output)\n",
+          cmd);
+  exit(EXIT_FAILURE);
+}
+
+/* ************************************************************************** */
+
+static bool _parse_uint(char* arg, uint* value)
+{
+  char* end;
+  unsigned long v = strtoul(arg, &end, 10);
+  if (end == arg || *end != '\0' || v > 0xFFFFFFFFUL) return false;
+  *value = (uint)v;
+  return true;
+}
+
+/* ************************************************************************** */
+
+static bool _parse_seed(char* arg, uint64_t* seed)
+{
+  char* end;
+  unsigned long long v = strtoull(arg, &end, 10);
+  if (end == arg || *end != '\0' || arg[0] == '-') return false;
+  *seed = v;
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* <min>:<max>, with min <= max */
+static bool _parse_range(char* arg, uint* min, uint* max)
+{
+  char* colon = strchr(arg, ':');
+  if (!colon) return false;
+  *colon = '\0';
+  bool ok = _parse_uint(arg, min) && _parse_uint(colon + 1, max) && *min <= *max;
+  *colon = ':';
+  return ok;
+}
+
+/* ************************************************************************** */
+
+int main(int argc, char* argv[])
+{
+  options opt = {.nb_rows = 7, .nb_cols = 7, .max_guesses = (uint)-1};
+  uint density = 20;
+  long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  opt.nb_threads = nb_cpus > 0 ? (uint)nb_cpus : 1;
+  char* output = NULL;
+
+  int a = 1;
+  for (; a < argc && argv[a][0] == '-' && argv[a][1] != '\0'; a++) {
+    char o = argv[a][1];
+    if (argv[a][2] != '\0') _usage(argv[0]);
+    if (o == 'w') {
+      opt.wrapping = true;
+      continue;
+    }
+    if (o == 'u') {
+      opt.unique = true;
+      continue;
+    }
+    if (a + 1 >= argc) _usage(argv[0]);
+    char* arg = argv[++a];
+    bool ok = true;
+    if (o == 'r') ok = _parse_uint(arg, &opt.nb_rows) && opt.nb_rows > 0;
+    else if (o == 'c') ok = _parse_uint(arg, &opt.nb_cols) && opt.nb_cols > 0;
+    else if (o == 'd') ok = _parse_uint(arg, &density) && density <= 100;
+    else if (o == 'j') ok = _parse_uint(arg, &opt.nb_threads) && opt.nb_threads > 0;
+    else if (o == 's') ok = _parse_seed(arg, &opt.seed);
+    else if (o == 'o') output = arg;
+    else if (o == 'g') ok = _parse_range(arg, &opt.min_guesses, &opt.max_guesses);
+    else ok = false;
+    if (!ok) _usage(argv[0]);
+  }
+  if (a != argc - 1 || !_parse_uint(argv[a], &opt.nb_games)) _usage(argv[0]);
+  opt.nb_walls = opt.nb_rows * opt.nb_cols * density / 100;
+
+  if (output) {
+    opt.out = corpus_open(output, true);
+    if (!opt.out) return EXIT_FAILURE;
+  } else {
+    printf("# seed rows cols wrapping walls unique guesses grid\n");
+  }
+
+  generator gen = {.opt = &opt, .stop = (opt.nb_games == 0)};
+  gen.window = opt.nb_threads * WINDOW_PER_THREAD;
+  gen.max_candidates = (uint64_t)opt.nb_games * MAX_CANDIDATES_PER_GAME;
+  gen.slots = calloc(gen.window, sizeof(slot));
+  pthread_t* threads = malloc(opt.nb_threads * sizeof(pthread_t));
+  assert(gen.slots && threads);
+  pthread_mutex_init(&gen.lock, NULL);
+  pthread_cond_init(&gen.window_moved, NULL);
+
+  double start = _now();
+  for (uint t = 0; t < opt.nb_threads; t++) pthread_create(&threads[t], NULL, _worker, &gen);
+  for (uint t = 0; t < opt.nb_threads; t++) pthread_join(threads[t], NULL);
+  double elapsed = _now() - start;
+
+  // candidates finished after the last game was written are discarded
+  for (uint k = 0; k < gen.window; k++)
+    if (gen.slots[k].g) game_delete(gen.slots[k].g);
+  free(gen.slots);
+  free(threads);
+  pthread_mutex_destroy(&gen.lock);
+  pthread_cond_destroy(&gen.window_moved);
+  if (output && !corpus_close(opt.out)) gen.write_error = true;
+  if (gen.write_error) fprintf(stderr, "Cannot write the games\n");
+
+  uint nb_not_unique = gen.nb_rejected[DONE_NOT_UNIQUE];
+  uint nb_difficulty = gen.nb_rejected[DONE_DIFFICULTY];
+  uint nb_draws = gen.nb_accepted + nb_not_unique + nb_difficulty;
+  fprintf(stderr, "%u games in %.3f s (%.1f games/s, %u threads)\n", gen.nb_accepted, elapsed,
+          elapsed > 0 ? gen.nb_accepted / elapsed : 0.0, opt.nb_threads);
+  fprintf(stderr,
+          "%u random games drawn, %u rejected (%.1f%%): %u without unique solution, %u out of difficulty range\n",
+          nb_draws, nb_not_unique + nb_difficulty,
+          nb_draws ? 100.0 * (nb_not_unique + nb_difficulty) / nb_draws : 0.0, nb_not_unique, nb_difficulty);
+  return (gen.nb_accepted == opt.nb_games && !gen.write_error) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,362 @@
+/**
+ * @file game_journal.c
+ * @brief Move journal, see game_journal.h.
+ * @copyright University of Bordeaux. All rights reserved, 2021.
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // strdup(), ftruncate()
+
+#include "game_journal.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_private.h"
+#include "queue.h"
+
+/* ************************************************************************** */
+/*                                  LAYOUT                                    */
+/* ************************************************************************** */
+
+/* snapshot:  0 "LUPJ"   4 version   8 size of the game   12 nb_undo   16 nb_redo
+ *            20 FNV-1a of bytes 0..19 and of the rest of the snapshot
+ *            24 the game, in the binary format of game_save_binary() (RLE)
+ *            then the undo stack and the redo stack, from the top, 10 bytes
+ *            per move: 0 i   4 j   8 old state   9 new state
+ * records:   1 byte: the journal_op, and the new state of a J_PLAY move << 4
+ *            the i and j of a J_PLAY move, as varints (7 bits per byte)
+ *            the low 16 bits of the FNV-1a of the previous bytes */
+
+#define JOURNAL_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 24
+#define MOVE_SIZE 10
+#define RECORD_MAX_SIZE 16
+
+/* the log is compacted when it is larger than both the snapshot and this size */
+#define JOURNAL_MIN_LOG 4096
+
+struct journal_s {
+  char* filename;
+  int fd;
+  size_t snapshot_size;
+  size_t log_size;  // bytes logged since the snapshot
+};
+
+/* ************************************************************************** */
+
+static void _put_u32(unsigned char* p, uint32_t v)
+{
+  for (uint k = 0; k < 4; k++) p[k] = (v >> (8 * k)) & 0xFF;
+}
+
+static uint32_t _get_u32(const unsigned char* p)
+{
+  return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ************************************************************************** */
+/*                                 SNAPSHOT                                   */
+/* ************************************************************************** */
+
+/* writes the moves of a stack from its top, and leaves the stack unchanged */
+static unsigned char* _put_stack(unsigned char* p, queue* q)
+{
+  for (int k = queue_length(q); k > 0; k--) {
+    move* m = queue_pop_head(q);
+    _put_u32(p, m->i);
+    _put_u32(p + 4, m->j);
+    p[8] = m->old;
+    p[9] = m->new;
+    p += MOVE_SIZE;
+    queue_push_tail(q, m);
+  }
+  return p;
+}
+
+/* ************************************************************************** */
+
+static unsigned char* _snapshot_encode(game g, size_t* size)
+{
+  size_t game_size;
+  unsigned char* bin = _binary_encode(g, true, &game_size);
+  if (bin == NULL) return NULL;
+  uint nb_undo = queue_length(g->undo_stack), nb_redo = queue_length(g->redo_stack);
+  *size = SNAPSHOT_HEADER_SIZE + game_size + ((size_t)nb_undo + nb_redo) * MOVE_SIZE;
+  unsigned char* buf = malloc(*size);
+  if (buf != NULL) {
+    memcpy(buf, "LUPJ", 4);
+    buf[4] = JOURNAL_VERSION;
+    buf[5] = buf[6] = buf[7] = 0;
+    _put_u32(buf + 8, game_size);
+    _put_u32(buf + 12, nb_undo);
+    _put_u32(buf + 16, nb_redo);
+    memcpy(buf + SNAPSHOT_HEADER_SIZE, bin, game_size);
+    _put_stack(_put_stack(buf + SNAPSHOT_HEADER_SIZE + game_size, g->undo_stack), g->redo_stack);
+    uint32_t h = _fnv1a(FNV1A_INIT, buf, 20);
+    _put_u32(buf + 20, _fnv1a(h, buf + SNAPSHOT_HEADER_SIZE, *size - SNAPSHOT_HEADER_SIZE));
+  }
+  free(bin);
+  return buf;
+}
+
+/* ************************************************************************** */
+
+static bool _get_stack(cgame g, const unsigned char* p, uint nb, queue* q)
+{
+  // the moves are stored from the top: they are pushed from the bottom
+  for (uint k = nb; k-- > 0;) {
+    const unsigned char* r = p + (size_t)k * MOVE_SIZE;
+    move m = {_get_u32(r), _get_u32(r + 4), r[8], r[9]};
+    if (m.i >= g->nb_rows || m.j >= g->nb_cols || !_check_square(m.old) || !_check_square(m.new)) return false;
+    _stack_push_move(q, m);
+  }
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* decodes the snapshot at the start of a journal, and returns its size */
+static game _snapshot_decode(const unsigned char* buf, size_t size, char* filename, size_t* snapshot_size)
+{
+  const char* bad = NULL;
+  size_t game_size = 0, nb_moves = 0;
+  if (size < SNAPSHOT_HEADER_SIZE || memcmp(buf, "LUPJ", 4) != 0)
+    bad = "not a journal";
+  else if (buf[4] != JOURNAL_VERSION)
+    bad = "unsupported version";
+  else {
+    game_size = _get_u32(buf + 8);
+    nb_moves = (size_t)_get_u32(buf + 12) + _get_u32(buf + 16);
+    if (game_size > size - SNAPSHOT_HEADER_SIZE || nb_moves > (size - SNAPSHOT_HEADER_SIZE - game_size) / MOVE_SIZE)
+      bad = "truncated snapshot";
+  }
+  if (!bad) {
+    *snapshot_size = SNAPSHOT_HEADER_SIZE + game_size + nb_moves * MOVE_SIZE;
+    uint32_t h = _fnv1a(FNV1A_INIT, buf, 20);
+    if (_get_u32(buf + 20) != _fnv1a(h, buf + SNAPSHOT_HEADER_SIZE, *snapshot_size - SNAPSHOT_HEADER_SIZE))
+      bad = "bad snapshot checksum";
+  }
+  if (bad) {
+    fprintf(stderr, "%s: invalid journal: %s\n", filename, bad);
+    return NULL;
+  }
+
+  game g = _binary_decode(buf + SNAPSHOT_HEADER_SIZE, game_size, filename);
+  if (g == NULL) return NULL;
+  const unsigned char* moves = buf + SNAPSHOT_HEADER_SIZE + game_size;
+  uint nb_undo = _get_u32(buf + 12);
+  if (!_get_stack(g, moves, nb_undo, g->undo_stack) ||
+      !_get_stack(g, moves + (size_t)nb_undo * MOVE_SIZE, _get_u32(buf + 16), g->redo_stack)) {
+    fprintf(stderr, "%s: invalid journal: bad move in the history\n", filename);
+    game_delete(g);
+    return NULL;
+  }
+  return g;
+}
+
+/* ************************************************************************** */
+/*                                  RECORDS                                   */
+/* ************************************************************************** */
+
+static size_t _put_varint(unsigned char* rec, size_t n, uint v)
+{
+  for (; v >= 0x80; v >>= 7) rec[n++] = (v & 0x7F) | 0x80;
+  rec[n++] = v;
+  return n;
+}
+
+/* ************************************************************************** */
+
+static bool _get_varint(const unsigned char** p, const unsigned char* end, uint* v)
+{
+  uint64_t value = 0;
+  for (uint shift = 0; *p < end && shift < 35; shift += 7) {
+    unsigned char b = *(*p)++;
+    value |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *v = (uint)value;
+      return value <= (uint)-1;
+    }
+  }
+  return false;
+}
+
+/* ************************************************************************** */
+
+/* replays a move on g, without the flags; false if the move is not valid */
+static bool _replay(game g, journal_op op, uint i, uint j, square s)
+{
+  move m;
+  switch (op) {
+    case J_PLAY:
+      if (i >= g->nb_rows || j >= g->nb_cols) return false;
+      if ((s != S_BLANK && s != S_LIGHTBULB && s != S_MARK) || (STATE(g, i, j) & S_BLACK)) return false;
+      m = (move){i, j, STATE(g, i, j), s};
+      SQUARE(g, i, j) = s;
+      _stack_clear(g->redo_stack);
+      _stack_push_move(g->undo_stack, m);
+      return true;
+    case J_UNDO:
+    case J_REDO: {
+      queue* from = (op == J_UNDO) ? g->undo_stack : g->redo_stack;
+      queue* to = (op == J_UNDO) ? g->redo_stack : g->undo_stack;
+      if (_stack_is_empty(from)) return false;
+      m = _stack_pop_move(from);
+      SQUARE(g, m.i, m.j) = (op == J_UNDO) ? m.old : m.new;
+      _stack_push_move(to, m);
+      return true;
+    }
+    case J_RESTART:
+      game_restart(g);
+      return true;
+  }
+  return false;
+}
+
+/* ************************************************************************** */
+
+/* replays the record at p, returns its size or 0 if it is truncated or not valid */
+static size_t _replay_record(game g, const unsigned char* p, const unsigned char* end)
+{
+  const unsigned char* start = p;
+  if (p == end) return 0;
+  journal_op op = *p & 0xF;
+  square s = *p++ >> 4;
+  uint i = 0, j = 0;
+  if (op == J_PLAY && (!_get_varint(&p, end, &i) || !_get_varint(&p, end, &j))) return 0;
+  if (end - p < 2) return 0;
+  uint32_t h = _fnv1a(FNV1A_INIT, start, p - start);
+  if (p[0] != (h & 0xFF) || p[1] != ((h >> 8) & 0xFF)) return 0;
+  p += 2;
+  return _replay(g, op, i, j, s) ? (size_t)(p - start) : 0;
+}
+
+/* ************************************************************************** */
+
+void _journal_log(game g, journal_op op, uint i, uint j, square s)
+{
+  journal* jn = g->journal;
+  assert(jn);
+  unsigned char rec[RECORD_MAX_SIZE];
+  size_t n = 0;
+  rec[n++] = op | (s << 4);
+  if (op == J_PLAY) {
+    n = _put_varint(rec, n, i);
+    n = _put_varint(rec, n, j);
+  }
+  uint32_t h = _fnv1a(FNV1A_INIT, rec, n);
+  rec[n++] = h & 0xFF;
+  rec[n++] = (h >> 8) & 0xFF;
+  // a single write: a crash leaves either the whole record or a truncated one
+  if (write(jn->fd, rec, n) != (ssize_t)n) {
+    fprintf(stderr, "%s: cannot write the journal, it is stopped\n", jn->filename);
+    game_journal_stop(g);
+    return;
+  }
+  jn->log_size += n;
+  if (jn->log_size > MAX(jn->snapshot_size, JOURNAL_MIN_LOG)) game_journal_compact(g);
+}
+
+/* ************************************************************************** */
+/*                                  JOURNAL                                   */
+/* ************************************************************************** */
+
+static journal* _journal_new(char* filename)
+{
+  journal* jn = malloc(sizeof(journal));
+  assert(jn);
+  jn->filename = strdup(filename);
+  assert(jn->filename);
+  jn->fd = -1;
+  jn->snapshot_size = jn->log_size = 0;
+  return jn;
+}
+
+/* ************************************************************************** */
+
+bool game_journal_start(game g, char* filename)
+{
+  assert(g && filename);
+  game_journal_stop(g);
+  g->journal = _journal_new(filename);
+  return game_journal_compact(g);
+}
+
+/* ************************************************************************** */
+
+bool game_journal_compact(game g)
+{
+  assert(g && g->journal);
+  journal* jn = g->journal;
+  size_t size;
+  unsigned char* buf = _snapshot_encode(g, &size);
+  bool ok = buf && _write_atomic(jn->filename, buf, size, false);
+  free(buf);
+  if (ok) {
+    // the log goes on in the new file, the old one has been renamed over
+    if (jn->fd >= 0) close(jn->fd);
+    jn->fd = open(jn->filename, O_WRONLY | O_APPEND);
+    ok = (jn->fd >= 0);
+  }
+  if (!ok) {
+    fprintf(stderr, "%s: cannot write the journal, it is stopped\n", jn->filename);
+    game_journal_stop(g);
+    return false;
+  }
+  jn->snapshot_size = size;
+  jn->log_size = 0;
+  return true;
+}
+
+/* ************************************************************************** */
+
+game game_journal_resume(char* filename)
+{
+  assert(filename);
+  size_t size, snapshot_size;
+  unsigned char* buf = (unsigned char*)_read_file(filename, &size);
+  if (buf == NULL) return NULL;
+  game g = _snapshot_decode(buf, size, filename, &snapshot_size);
+  if (g == NULL) {
+    free(buf);
+    return NULL;
+  }
+  size_t end = snapshot_size;
+  for (size_t n; (n = _replay_record(g, buf + end, buf + size)) > 0;) end += n;
+  free(buf);
+  game_update_flags(g);
+
+  journal* jn = _journal_new(filename);
+  jn->fd = open(filename, O_WRONLY | O_APPEND);
+  jn->snapshot_size = snapshot_size;
+  jn->log_size = end - snapshot_size;
+  g->journal = jn;
+  // an interrupted last record is dropped, so that the next ones can be read
+  if (jn->fd < 0 || (end < size && ftruncate(jn->fd, end) != 0)) {
+    fprintf(stderr, "%s: cannot write the journal\n", filename);
+    game_delete(g);
+    return NULL;
+  }
+  if (end < size) fprintf(stderr, "%s: %zu bytes of an interrupted record dropped\n", filename, size - end);
+  return g;
+}
+
+/* ************************************************************************** */
+
+void game_journal_stop(game g)
+{
+  assert(g);
+  journal* jn = g->journal;
+  if (jn == NULL) return;
+  if (jn->fd >= 0) close(jn->fd);
+  free(jn->filename);
+  free(jn);
+  g->journal = NULL;
+}
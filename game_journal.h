@@ -0,0 +1,65 @@
+/**
+ * @file game_journal.h
+ * @brief Move journal: crash-safe persistence of a game and of its history.
+ * @details A journal file starts with a snapshot of the game and of its undo
+ * and redo stacks, followed by an append-only log of the moves played since:
+ * each @ref game_play_move, @ref game_undo, @ref game_redo and
+ * @ref game_restart of a journaled game appends a record of a few bytes, in a
+ * single write. The cost of a move does not depend on the size of the board.
+ * When the log grows larger than the snapshot, the journal is compacted: a new
+ * snapshot replaces the file atomically, which keeps the amortized cost of a
+ * move constant. If the program dies, @ref game_journal_resume rebuilds the
+ * game with its full history from the last snapshot and the logged moves.
+ * @copyright University of Bordeaux. All rights reserved, 2021.
+ **/
+
+#ifndef __GAME_JOURNAL_H__
+#define __GAME_JOURNAL_H__
+
+#include <stdbool.h>
+
+#include "game.h"
+
+/**
+ * @brief Starts a journal for a game.
+ * @details The journal file is created (or replaced) with a snapshot of the
+ * game and of its history, then every move of the game is logged until
+ * @ref game_journal_stop or @ref game_delete. A game has at most one journal:
+ * a previous one is stopped.
+ * @param g the game
+ * @param filename the journal file
+ * @return true if the journal has been started, false otherwise (reported on
+ * stderr)
+ **/
+bool game_journal_start(game g, char* filename);
+
+/**
+ * @brief Rebuilds a game from its journal, and goes on logging its moves.
+ * @details The game, with its undo and redo stacks, is rebuilt from the
+ * snapshot and the logged moves. An interrupted last record (the program died
+ * while writing it) is dropped.
+ * @param filename the journal file
+ * @return the rebuilt game, with its journal started, or NULL if the file can
+ * not be read or its snapshot is not valid (reported on stderr)
+ **/
+game game_journal_resume(char* filename);
+
+/**
+ * @brief Compacts the journal of a game.
+ * @details The journal file is replaced atomically by a snapshot of the
+ * current game and of its history. This is done automatically when the log
+ * grows larger than the snapshot.
+ * @param g the game, with a journal
+ * @return true if the journal has been compacted, false otherwise (the
+ * journal is then stopped)
+ **/
+bool game_journal_compact(game g);
+
+/**
+ * @brief Stops the journal of a game, if any.
+ * @details The journal file is kept: it can be resumed later.
+ * @param g the game
+ **/
+void game_journal_stop(game g);
+
+#endif  // __GAME_JOURNAL_H__
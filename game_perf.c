@@ -0,0 +1,160 @@
+/**
+ * @file game_perf.c
+ * @brief Checks the solver against the reference times of a benchmark corpus.
+ * @details Usage: game_perf [-s|-c] [-k factor] <corpus.txt> [puzzle], times
+ * game_solve() (-s) and/or game_nb_solutions() (-c) on every puzzle of the
+ * corpus (see perf/corpus.txt), or on the one named (its file name without
+ * .txt). A check fails if the solved game is not over, if the number of
+ * solutions differs from the recorded one, or if the best of up to
+ * PERF_RUNS runs takes longer than factor (20 by default) times the reference
+ * time, plus PERF_SLACK_MS for the timer and scheduler noise on the shortest
+ * puzzles.
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime()
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_tools.h"
+
+/* a check runs at most that many times, until one run is within its limit */
+#define PERF_RUNS 3
+
+/* added to every time limit, in ms */
+#define PERF_SLACK_MS 1.0
+
+/* ************************************************************************** */
+
+static double _now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+
+/* times one game_solve() of the puzzle in ms, false if the result is not solved */
+static bool _time_solve(cgame puzzle, double* ms)
+{
+  game g = game_copy(puzzle);
+  double start = _now();
+  bool solved = game_solve(g);
+  *ms = (_now() - start) * 1e3;
+  solved = solved && game_is_over(g);
+  game_delete(g);
+  return solved;
+}
+
+/* times one game_nb_solutions() of the puzzle in ms, false if the count is wrong */
+static bool _time_count(cgame puzzle, uint solutions, double* ms)
+{
+  double start = _now();
+  uint nb = game_nb_solutions(puzzle);
+  *ms = (_now() - start) * 1e3;
+  if (nb != solutions) fprintf(stderr, "found %u solutions instead of %u\n", nb, solutions);
+  return nb == solutions;
+}
+
+/* ************************************************************************** */
+
+/* runs one check of a puzzle (count if !solve), prints its result */
+static bool _check(const char* name, cgame puzzle, bool solve, uint solutions, double ref_ms, double factor)
+{
+  double limit = factor * ref_ms + PERF_SLACK_MS;
+  double best = -1;
+  bool ok = true;
+  for (uint r = 0; r < PERF_RUNS && ok && !(best >= 0 && best <= limit); r++) {
+    double ms;
+    ok = solve ? _time_solve(puzzle, &ms) : _time_count(puzzle, solutions, &ms);
+    if (best < 0 || ms < best) best = ms;
+  }
+  bool fast = ok && best <= limit;
+  printf("%-18s %-5s %9.1f ms (reference %7.1f ms, limit %9.1f ms): %s\n", name, solve ? "solve" : "count", best,
+         ref_ms, limit, !ok ? (solve ? "NOT SOLVED" : "WRONG COUNT") : fast ? "ok" : "TOO SLOW");
+  return fast;
+}
+
+/* ************************************************************************** */
+
+static void _usage(char* cmd)
+{
+  fprintf(stderr, "Usage: %s [-s|-c] [-k factor] <corpus.txt> [puzzle]\n", cmd);
+  exit(EXIT_FAILURE);
+}
+
+/* ************************************************************************** */
+
+int main(int argc, char* argv[])
+{
+  bool solve = true, count = true;
+  double factor = 20;
+  int a = 1;
+  for (; a < argc && argv[a][0] == '-'; a++) {
+    if (strcmp(argv[a], "-s") == 0) {
+      count = false;
+    } else if (strcmp(argv[a], "-c") == 0) {
+      solve = false;
+    } else if (strcmp(argv[a], "-k") == 0 && a + 1 < argc) {
+      char* end;
+      factor = strtod(argv[++a], &end);
+      if (end == argv[a] || *end != '\0' || factor <= 0) _usage(argv[0]);
+    } else {
+      _usage(argv[0]);
+    }
+  }
+  if (!solve && !count) _usage(argv[0]);
+  if (a != argc - 1 && a != argc - 2) _usage(argv[0]);
+  char* corpus_name = argv[a];
+  char* only = (a == argc - 2) ? argv[a + 1] : NULL;
+
+  FILE* corpus = fopen(corpus_name, "r");
+  if (!corpus) {
+    fprintf(stderr, "Cannot open %s\n", corpus_name);
+    return EXIT_FAILURE;
+  }
+  // the puzzle files are next to the corpus file
+  const char* slash = strrchr(corpus_name, '/');
+  int dir_len = slash ? (int)(slash - corpus_name + 1) : 0;
+
+  char line[256];
+  uint nb_puzzles = 0, nb_failed = 0;
+  while (fgets(line, sizeof(line), corpus)) {
+    char file[128], path[512];
+    uint solutions;
+    double solve_ms, count_ms;
+    if (line[0] == '#' || line[0] == '\n') continue;
+    if (sscanf(line, "%127s %u %lf %lf", file, &solutions, &solve_ms, &count_ms) != 4) {
+      fprintf(stderr, "%s: invalid line: %s", corpus_name, line);
+      fclose(corpus);
+      return EXIT_FAILURE;
+    }
+    char* ext = strstr(file, ".txt");
+    char name[128];
+    snprintf(name, sizeof(name), "%.*s", ext ? (int)(ext - file) : (int)strlen(file), file);
+    if (only && strcmp(only, name) != 0) continue;
+
+    snprintf(path, sizeof(path), "%.*s%s", dir_len, corpus_name, file);
+    game puzzle = game_load(path);
+    nb_puzzles++;
+    if (!puzzle) {
+      nb_failed++;
+      continue;
+    }
+    if (solve && !_check(name, puzzle, true, solutions, solve_ms, factor)) nb_failed++;
+    if (count && !_check(name, puzzle, false, solutions, count_ms, factor)) nb_failed++;
+    game_delete(puzzle);
+  }
+  fclose(corpus);
+
+  if (nb_puzzles == 0) {
+    fprintf(stderr, "%s: no puzzle %s\n", corpus_name, only ? only : "");
+    return EXIT_FAILURE;
+  }
+  return nb_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -15,6 +15,10 @@
 #include "game_ext.h"
 #include "queue.h"
 
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
 /* ************************************************************************** */
 /*                             STACK ROUTINES                                 */
 /* ************************************************************************** */
@@ -220,145 +224,127 @@ uint _neigh_count(cgame g, uint i, uint j, square s, uint m, bool diag)
 }
 
 /* ************************************************************************** */
-/*                                 SOLVE                                      */
+/*                                 RANDOM                                     */
 /* ************************************************************************** */
 
-// transforms the index into row and column indexes
-static void _pos_to_row_col(game g, uint index, int* prow, int* pcolumn)
+/* https://prng.di.unimi.it/splitmix64.c */
+static uint64_t _splitmix64(uint64_t* x)
 {
-  int nb_col = game_nb_cols(g);
-  *prow = index / nb_col;
-  *pcolumn = index % nb_col;
+  uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
 }
 
-// true if at least 1 square has an error, false otherwise
-static bool _game_has_error_full(game g)
+/* ************************************************************************** */
+
+void _rng_seed(rng* r, uint64_t seed)
 {
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_get_flags(g, i, j) == F_ERROR) {
-        return true;
-      }
-    }
-  return false;
+  assert(r);
+  for (uint k = 0; k < 4; k++) r->s[k] = _splitmix64(&seed);
 }
 
-// marks all the squares neighbouring 0 walls
-static void _game_solve_mark_wall_0(game g)
+/* ************************************************************************** */
+
+static uint64_t _rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+/* https://prng.di.unimi.it/xoshiro256starstar.c */
+uint64_t _rng_next(rng* r)
 {
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_is_black(g, i, j) && game_get_black_number(g, i, j) == 0) {
-        int newI = i;
-        int newJ = j;
-        if (_next(g, &newI, &newJ, UP) && game_check_move(g, newI, newJ, S_MARK))
-          game_set_square(g, newI, newJ, S_MARK);
-
-        newI = i;
-        newJ = j;
-        if (_next(g, &newI, &newJ, DOWN) && game_check_move(g, newI, newJ, S_MARK))
-          game_set_square(g, newI, newJ, S_MARK);
-
-        newI = i;
-        newJ = j;
-        if (_next(g, &newI, &newJ, LEFT) && game_check_move(g, newI, newJ, S_MARK))
-          game_set_square(g, newI, newJ, S_MARK);
-
-        newI = i;
-        newJ = j;
-        if (_next(g, &newI, &newJ, RIGHT) && game_check_move(g, newI, newJ, S_MARK))
-          game_set_square(g, newI, newJ, S_MARK);
-      }
-    }
+  assert(r);
+  uint64_t* s = r->s;
+  uint64_t result = _rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = _rotl(s[3], 45);
+  return result;
 }
 
-// place mandatory lights to solve a game
-static bool _game_solve_necessary_light(game g)
+/* ************************************************************************** */
+
+/* Lemire's multiply-and-reject method, on 32 bits */
+uint _rng_below(rng* r, uint n)
 {
-  bool played = false;
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_is_black(g, i, j)) {
-        if (game_get_black_number(g, i, j) - _neigh_count(g, i, j, S_LIGHTBULB, 0xF, false) ==
-            _neigh_count(g, i, j, S_BLANK, 0xFFFF, false)) {
-          for (int offset = -1; offset < 2; offset += 2) {
-            if (game_check_move(g, i + offset, j, S_LIGHTBULB) && game_get_square(g, i + offset, j) == S_BLANK) {
-              played = true;
-              game_set_square(g, i + offset, j, S_LIGHTBULB);
-            }
-            if (game_check_move(g, i, j + offset, S_LIGHTBULB) && game_get_square(g, i, j + offset) == S_BLANK) {
-              played = true;
-              game_set_square(g, i, j + offset, S_LIGHTBULB);
-            }
-          }
-        }
-        if (played) game_update_flags(g);
-      }
+  assert(n > 0);
+  uint64_t m = (_rng_next(r) >> 32) * (uint64_t)n;
+  uint32_t low = (uint32_t)m;
+  if (low < n) {
+    uint32_t threshold = (uint32_t)(-n) % n;
+    while (low < threshold) {
+      m = (_rng_next(r) >> 32) * (uint64_t)n;
+      low = (uint32_t)m;
     }
-  if (played) _game_solve_necessary_light(g);
-  return played;
+  }
+  return (uint)(m >> 32);
 }
 
-void game_solve_preprocessing(game g)
-{
-  _game_solve_mark_wall_0(g);
-  _game_solve_necessary_light(g);
-}
+/* ************************************************************************** */
+/*                               GRID KERNELS                                 */
+/* ************************************************************************** */
 
-bool game_solve_rec(game g, int pos, int len, unsigned int* count, bool isCounting, bool* playableSquares)
+/* a square is an int-sized enum: a 128-bit vector holds 4 of them */
+
+void _grid_clear_flags(square* squares, size_t n)
 {
-  // stops the recursive branch if it generates a game with errors
-  if (_game_has_error_full(g)) {
-    return false;
-  }
+  size_t k = 0;
+#ifdef __wasm_simd128__
+  v128_t mask = wasm_i32x4_splat(S_MASK);
+  for (; k + 4 <= n; k += 4) wasm_v128_store(&squares[k], wasm_v128_and(wasm_v128_load(&squares[k]), mask));
+#endif
+  for (; k < n; k++) squares[k] &= S_MASK;
+}
 
-  // increment the position until it's a non lighted playable square
-  int row, column;
-  _pos_to_row_col(g, pos, &row, &column);
-  while (!playableSquares[pos] || game_get_flags(g, row, column) == F_LIGHTED) {
-    if (pos == len) break;
-    pos++;
-    _pos_to_row_col(g, pos, &row, &column);
-  }
+/* ************************************************************************** */
 
-  // checks if a game is over once it has been generated
-  if (pos == len) {
-    if (game_is_over(g)) {
-      (*count)++;
-      return true;
-    }
-    return false;
+void _grid_restart(square* squares, size_t n)
+{
+  size_t k = 0;
+#ifdef __wasm_simd128__
+  v128_t mask = wasm_i32x4_splat(S_MASK);
+  v128_t black = wasm_i32x4_splat(S_BLACK);
+  for (; k + 4 <= n; k += 4) {
+    v128_t v = wasm_v128_load(&squares[k]);
+    v128_t walls = wasm_i32x4_eq(wasm_v128_and(v, black), black);  // all ones on walls
+    wasm_v128_store(&squares[k], wasm_v128_and(wasm_v128_and(v, mask), walls));
   }
+#endif
+  for (; k < n; k++) squares[k] = (squares[k] & S_BLACK) ? (squares[k] & S_MASK) : S_BLANK;
+}
 
-  // extend the game with a lightbulb at the next position if possible
-  if (game_check_move(g, row, column, S_LIGHTBULB)) {
-    game_set_square(g, row, column, S_LIGHTBULB);
-    game_update_flags(g);
-  }
-  if (game_solve_rec(g, pos + 1, len, count, isCounting, playableSquares) && !isCounting) {
-    return true;
-  }
+/* ************************************************************************** */
 
-  // extend the game with a blank square at the next position
-  if (game_check_move(g, row, column, S_BLANK)) {
-    game_set_square(g, row, column, S_BLANK);
-    game_update_flags(g);
-  }
-  if (game_solve_rec(g, pos + 1, len, count, isCounting, playableSquares) && !isCounting) {
-    return true;
-  }
-  return false;
+bool _grid_equal(const square* a, const square* b, size_t n)
+{
+  size_t k = 0;
+#ifdef __wasm_simd128__
+  for (; k + 4 <= n; k += 4)
+    if (wasm_v128_any_true(wasm_v128_xor(wasm_v128_load(&a[k]), wasm_v128_load(&b[k])))) return false;
+#endif
+  for (; k < n; k++)
+    if (a[k] != b[k]) return false;
+  return true;
 }
 
-void game_solve_update_playable_squares(game g, bool* tab)
+/* ************************************************************************** */
+
+bool _grid_is_over(const square* squares, size_t n)
 {
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_get_flags(g, i, j) == F_LIGHTED || game_is_black(g, i, j) || game_get_state(g, i, j) == S_MARK) {
-        tab[INDEX(g, i, j)] = false;
-      } else {
-        tab[INDEX(g, i, j)] = true;
-      }
-    }
-  tab[INDEX(g, g->nb_rows, 0)] = false;
+  size_t k = 0;
+#ifdef __wasm_simd128__
+  v128_t zero = wasm_i32x4_splat(0);
+  v128_t done = wasm_i32x4_splat(S_BLACK | F_LIGHTED);
+  v128_t error = wasm_i32x4_splat(F_ERROR);
+  for (; k + 4 <= n; k += 4) {
+    v128_t v = wasm_v128_load(&squares[k]);
+    v128_t unlit = wasm_i32x4_eq(wasm_v128_and(v, done), zero);
+    if (wasm_v128_any_true(wasm_v128_or(unlit, wasm_v128_and(v, error)))) return false;
+  }
+#endif
+  for (; k < n; k++)
+    if (!(squares[k] & (S_BLACK | F_LIGHTED)) || (squares[k] & F_ERROR)) return false;
+  return true;
 }
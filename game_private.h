@@ -8,6 +8,8 @@
 #define __GAME_PRIVATE_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "game.h"
 #include "queue.h"
@@ -26,6 +28,11 @@
 /*                             DATA TYPES                                     */
 /* ************************************************************************** */
 
+/**
+ * @brief Move journal of a game (see game_journal.c).
+ */
+typedef struct journal_s journal;
+
 /**
  * @brief Game structure.
  * @details This is an opaque data type.
@@ -37,6 +44,8 @@ struct game_s {
   bool wrapping;     /**< the wrapping option */
   queue* undo_stack; /**< stack to undo moves */
   queue* redo_stack; /**< stack to redo moves */
+  journal* journal;  /**< move journal (see game_journal.h), NULL if none */
+  bool stale;        /**< squares set since the last game_update_flags(), see _update_flags_at() */
 };
 
 /**
@@ -62,6 +71,16 @@ typedef enum { HERE, UP, DOWN, LEFT, RIGHT, UP_LEFT, UP_RIGHT, DOWN_LEFT, DOWN_R
 #define FLAGS(g, i, j) (SQUARE(g, i, j) & F_MASK)
 #define MAX(x, y) ((x > (y)) ? (x) : (y))
 
+/* with GAME_ORACLE (cmake -DORACLE=ON), every move is checked against game_update_flags() */
+#ifdef GAME_ORACLE
+#define ORACLE_CHECK(g, call)                 \
+  do {                                        \
+    if (!_oracle_check((g), (call))) abort(); \
+  } while (0)
+#else
+#define ORACLE_CHECK(g, call) ((void)0)
+#endif
+
 /* ************************************************************************** */
 /*                             STACK ROUTINES                                 */
 /* ************************************************************************** */
@@ -107,6 +126,35 @@ int _str2square(char c);
 
 bool _check_square(square s);
 
+/**
+ * @brief updates the flags after a change of a single square
+ *
+ * @details Incremental version of game_update_flags(): only the row and column
+ * segments of the square (the squares a light bulb there would light), and the
+ * walls next to them, can change. The other flags must be up to date: if the
+ * game has been changed by game_set_square() or game_new_ext() since its last
+ * update, all the flags are updated instead.
+ *
+ * @param g the game, where (i,j) holds its new state and its previous flags
+ * @param i row index
+ * @param j column index
+ * @param old the previous state of (i,j)
+ */
+void _update_flags_at(game g, uint i, uint j, square old);
+
+/**
+ * @brief checks the flags of a game against game_update_flags()
+ *
+ * @details game_update_flags() recomputes all the flags from scratch on a copy
+ * of the game: it is the reference of the incremental updates. On a difference,
+ * the board and the differing squares are printed on stderr.
+ *
+ * @param g the game
+ * @param call the call which has just updated the flags, for the report
+ * @return true if the flags are the same as the reference ones
+ */
+bool _oracle_check(cgame g, const char* call);
+
 /* ************************************************************************** */
 /*                                 NEIGHBORHOOD                               */
 /* ************************************************************************** */
@@ -212,40 +260,226 @@ uint _neigh_size(cgame g, uint i, uint j, bool diag);
 uint _neigh_count(cgame g, uint i, uint j, square s, uint m, bool diag);
 
 /* ************************************************************************** */
-/*                                 SOLVE                                      */
+/*                                 RANDOM                                     */
+/* ************************************************************************** */
+
+/**
+ * @brief Random number generator state (xoshiro256**, seeded with splitmix64).
+ * @details Each generation call owns its state: no global state is shared
+ * between threads, and a given seed draws the same numbers on every platform.
+ */
+typedef struct {
+  uint64_t s[4];
+} rng;
+
+/**
+ * @brief initializes a random number generator from a seed
+ *
+ * @param r the generator state
+ * @param seed any value, the same seed gives the same sequence
+ */
+void _rng_seed(rng* r, uint64_t seed);
+
+/**
+ * @brief draws the next 64-bit random number
+ *
+ * @param r the generator state
+ * @return a uniformly distributed 64-bit number
+ */
+uint64_t _rng_next(rng* r);
+
+/**
+ * @brief draws a random number in [0, n), without modulo bias
+ *
+ * @param r the generator state
+ * @param n the upper bound
+ * @pre @p n > 0
+ * @return a uniformly distributed number in [0, n)
+ */
+uint _rng_below(rng* r, uint n);
+
+/* ************************************************************************** */
+/*                               GRID KERNELS                                 */
+/* ************************************************************************** */
+
+/* Scans of the whole grid, as a flat array of n squares. With the wasm SIMD
+ * extension (__wasm_simd128__, see web/Makefile) they process 4 squares per
+ * instruction, otherwise they are plain loops. */
+
+/**
+ * @brief clears the flags of every square, keeping their state
+ *
+ * @param squares the grid
+ * @param n the number of squares
+ */
+void _grid_clear_flags(square* squares, size_t n);
+
+/**
+ * @brief keeps the walls (without their flags) and blanks every other square
+ *
+ * @param squares the grid
+ * @param n the number of squares
+ */
+void _grid_restart(square* squares, size_t n);
+
+/**
+ * @brief compares two grids, flags included
+ *
+ * @param a the first grid
+ * @param b the second grid
+ * @param n the number of squares of each
+ * @return true if all the squares are equal
+ */
+bool _grid_equal(const square* a, const square* b, size_t n);
+
+/**
+ * @brief checks that every square is a wall or lighted, and has no error
+ *
+ * @param squares the grid, with up to date flags
+ * @param n the number of squares
+ * @return true if the grid is solved
+ */
+bool _grid_is_over(const square* squares, size_t n);
+
+/* ************************************************************************** */
+/*                               SAVE FORMATS                                 */
 /* ************************************************************************** */
 
 /**
- * @brief recursively solves the game
+ * @brief reads a whole file with a single read
+ *
+ * @param filename the file
+ * @param size receives the size of the file, in bytes
+ * @return the content of the file followed by a '\0', to be freed by the
+ * caller, or NULL on error (reported on stderr)
+ */
+char* _read_file(char* filename, size_t* size);
+
+/**
+ * @brief writes a file atomically
+ * @details The buffer is written to a new temporary file next to the target
+ * (.name.XXXXXX, see mkstemp()), which is then renamed over the target, with
+ * the mode of the target (0644 for a new file). Concurrent writes of the same
+ * file each use their own temporary file: the last rename wins.
+ *
+ * @param filename the target file
+ * @param buf the content of the file
+ * @param size the size of the content, in bytes
+ * @param sync if true, the file and its directory are flushed with fsync()
+ * @return true if the file has been written, false otherwise (reported on
+ * stderr, and the target is left unchanged)
+ */
+bool _write_atomic(char* filename, const void* buf, size_t size, bool sync);
+
+/**
+ * @brief renders a game in the text format of @ref game_save
  *
  * @param g the game
- * @param pos the starting position
- * @param count pointer for the number of solution found
- * @pre @p count must be initialized at 0
- * @param isCounting false if the solver should stop at the first solution found, true to test all possible moves
- * @param playableSquares array of booleans representing the squares playability, see game_solve_update_playable_squares
+ * @param size receives the size of the text, in bytes (no terminating '\0')
+ * @return the text, to be freed by the caller, or NULL if out of memory
+ */
+char* _text_encode(cgame g, size_t* size);
+
+/**
+ * @brief parses a game in the text format of @ref game_load
  *
- * @return true if a solution has been found, false otherwise
+ * @param buf the text, which does not need a terminating '\0'
+ * @param size the size of the text, in bytes
+ * @param name the name reported in error messages, with the line and column
+ * @return the parsed game, or NULL if the text is invalid
+ */
+game _text_decode(const char* buf, size_t size, const char* name);
+
+/**
+ * @brief Initial value of a FNV-1a hash.
  */
-bool game_solve_rec(game g, int pos, int len, unsigned int* count, bool isCounting, bool* playableSquares);
+#define FNV1A_INIT 2166136261u
 
 /**
- * @brief update the given array with the game's squares playability
+ * @brief updates a 32-bit FNV-1a hash
  *
- * @details a square is not playable if it's either a wall, marked or lighted otherwise it's playable
+ * @param h the hash of the previous bytes, or FNV1A_INIT
+ * @param buf the bytes to hash
+ * @param size the number of bytes
+ * @return the updated hash
+ */
+uint32_t _fnv1a(uint32_t h, const void* buf, size_t size);
+
+/**
+ * @brief encodes a game in the binary format of @ref game_save_binary
  *
  * @param g the game
- * @param tab array of booleans
- * @pre @p tab must have a minium length equals to the numbers of squares in the game
+ * @param rle if true, runs of blank squares are run-length encoded
+ * @param size receives the size of the encoding, in bytes
+ * @return the encoding, to be freed by the caller, or NULL if out of memory
+ */
+unsigned char* _binary_encode(cgame g, bool rle, size_t* size);
+
+/**
+ * @brief decodes a game in the binary format of @ref game_save_binary
+ *
+ * @param buf the encoding
+ * @param size the size of the encoding, in bytes
+ * @param name the name reported in error messages
+ * @return the decoded game, or NULL if the encoding is invalid
+ */
+game _binary_decode(const unsigned char* buf, size_t size, const char* name);
+
+/**
+ * @brief tests whether a buffer starts with the magic number of the binary format
+ *
+ * @param buf the buffer
+ * @param size the size of the buffer, in bytes
+ * @return true if the buffer holds a binary encoded game
  */
-void game_solve_update_playable_squares(game g, bool* tab);
+bool _is_binary(const void* buf, size_t size);
+
+/* ************************************************************************** */
+/*                                 SOLVE                                      */
+/* ************************************************************************** */
 
 /**
- * @brief makes the game easier to solve for the solver
+ * @brief counts the solutions of a game, up to a given limit
+ *
+ * @details Fast counter based on constraint propagation over the row and column
+ * segments of the grid (see game_solver.c), behind game_solve() and
+ * game_nb_solutions(). The light bulbs already played are kept and the marked
+ * squares can not be light bulbs.
  *
- * @details marks all the neighbours of 0 walls and place the mandatory lights to win the game
+ * The search takes exponential time in the worst case: a budget bounds its
+ * number of guesses.
  *
  * @param g the game
+ * @param limit the search stops as soon as @p limit solutions are found
+ * @param budget the search gives up after @p budget guesses, (uint)-1 for none
+ * @param solution if not NULL, receives the square states of the last solution
+ * found (row-major, nb_rows * nb_cols squares)
+ * @param nb_guesses if not NULL, receives the number of branching points of the
+ * search (0 when propagation alone solves the game)
+ * @return the number of solutions found, at most @p limit, or SOLVE_UNKNOWN if
+ * the budget ran out before the search could tell
+ */
+uint _solve_count(cgame g, uint limit, uint budget, square* solution, uint* nb_guesses);
+
+/** returned by _solve_count() when its budget runs out */
+#define SOLVE_UNKNOWN ((uint)-1)
+
+/* ************************************************************************** */
+/*                                  JOURNAL                                   */
+/* ************************************************************************** */
+
+/** kinds of journal records */
+typedef enum { J_PLAY = 1, J_UNDO, J_REDO, J_RESTART } journal_op;
+
+/**
+ * @brief logs a move of a game which has a journal
+ *
+ * @param g the game, with g->journal != NULL
+ * @param op the kind of move
+ * @param i row index of a J_PLAY move
+ * @param j column index of a J_PLAY move
+ * @param s new state of a J_PLAY move
  */
-void game_solve_preprocessing(game g);
+void _journal_log(game g, journal_op op, uint i, uint j, square s);
+
 #endif  // __GAME_PRIVATE_H__
@@ -33,27 +33,56 @@ int main(int argc, char** argv)
 
   Env* env = init(win, ren, argc, argv);
 
-  /* main render loop */
+  /* main loop: sleeps until an event arrives, and renders only when needed */
   SDL_Event e;
   bool quit = false;
+  uint nb_frames = 0;
+  double process_ms = 0;  // since the last frame
+  bool first_full_frame = false;  // rendered with the assets
+  Uint64 render_time = 0;  // performance counter ticks spent in render()
+  Uint32 start = SDL_GetTicks();
+  env->redraw = true;
   while (!quit) {
-    /* manage events */
-    while (SDL_PollEvent(&e)) {
-      /* process your events */
-      quit = process(win, ren, env, &e);
-      if (quit) break;
+    /* wait for events, or for the next frame of an animation */
+    if (SDL_WaitEventTimeout(&e, env->animating ? DELAY : IDLE_DELAY)) {
+      do {
+        /* process your events */
+        Uint64 process_start = SDL_GetPerformanceCounter();
+        quit = process(win, ren, env, &e);
+        process_ms += _ms_since(process_start);
+      } while (!quit && SDL_PollEvent(&e));
     }
+    if (quit || !(env->redraw || env->animating)) continue;
+    env->redraw = false;
 
     /* background in gray */
     SDL_SetRenderDrawColor(ren, 0xA0, 0xA0, 0xA0, 0xFF);
     SDL_RenderClear(ren);
 
     /* render all what you want */
+    Uint64 render_start = SDL_GetPerformanceCounter();
     render(win, ren, env);
+    Uint64 render_end = SDL_GetPerformanceCounter();
+    render_time += render_end - render_start;
     SDL_RenderPresent(ren);
-    SDL_Delay(DELAY);
+    nb_frames++;
+    double render_ms = 1e3 * (render_end - render_start) / SDL_GetPerformanceFrequency();
+    _hud_frame(env, process_ms, render_ms, _ms_since(render_start));
+    process_ms = 0;
+    if (nb_frames == 1) _startup_mark(env, "first frame");
+    if (!env->loading && !first_full_frame) {
+      first_full_frame = true;
+      _startup_mark(env, "first full frame");
+    }
   }
 
+  /* frames skipped, compared to a redraw every DELAY ms */
+  Uint32 elapsed = SDL_GetTicks() - start;
+  uint nb_periods = elapsed / DELAY;
+  double frame_ms = nb_frames ? 1e3 * render_time / SDL_GetPerformanceFrequency() / nb_frames : 0.0;
+  PRINT("%u frames rendered in %.1f s (%.2f ms per render), %u skipped\n", nb_frames, elapsed / 1000.0, frame_ms,
+        nb_periods > nb_frames ? nb_periods - nb_frames : 0);
+
   /* clean your environment */
   clean(win, ren, env);
 
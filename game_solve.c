@@ -10,23 +10,47 @@
 #include "game_private.h"
 #include "game_tools.h"
 
+/* the solution of a binary game is saved in the binary format as well */
+static bool _is_binary_file(char* filename)
+{
+  char magic[4];
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) return false;
+  size_t n = fread(magic, 1, sizeof(magic), file);
+  fclose(file);
+  return _is_binary(magic, n);
+}
+
 int main(int argc, char* argv[])
 {
+  // "game_solve -s|-c -d <desc> [output]" reads the game from a Tatham description
+  bool from_desc = argc >= 3 && strcmp(argv[2], "-d") == 0;
+  if (from_desc) {
+    for (int a = 2; a < argc; a++) argv[a] = argv[a + 1];
+    argc--;
+  }
   if (argc < 3) {  // check if the user gave the correct number of arguments
     printf("few arguments\n");
     return EXIT_FAILURE;
   }
   char* filename = NULL;
-  if (argc == 3) {  // if the output file is not defined by the user, the game creates a new one instead
+  if (argc == 3 && !from_desc) {  // if the output file is not defined by the user, the game creates a new one instead
     filename = "default.txt";
   } else if (argc >= 4) {
     filename = argv[3];
   }
 
-  game g = game_load(argv[2]);  // load the input game and place the solution inside the output file
+  // load the input game and place the solution inside the output file
+  game g = from_desc ? game_from_desc(argv[2]) : game_load(argv[2]);
+  if (g == NULL) return EXIT_FAILURE;
   if (strcmp("-s", argv[1]) == 0) {
     if (game_solve(g)) {
-      game_save(g, filename);
+      bool binary = !from_desc && _is_binary_file(argv[2]);
+      bool saved = !filename || (binary ? game_save_binary(g, filename, true) : game_save(g, filename));
+      if (!saved) {
+        game_delete(g);
+        return EXIT_FAILURE;
+      }
       if (argc == 3) {
         game_print(g);
       }
@@ -35,14 +59,16 @@ int main(int argc, char* argv[])
       return EXIT_FAILURE;
     }
   } else if (strcmp("-c", argv[1]) == 0) {  // store the number of solutions inside the output file
-    FILE* file = fopen(filename, "w");
     uint solutions = game_nb_solutions(g);
-    fprintf(file, "%u\n", solutions);
+    if (filename) {
+      FILE* file = fopen(filename, "w");
+      fprintf(file, "%u\n", solutions);
+      fclose(file);
+    }
     if (argc == 3) {
       printf("we found %u solutions\n", solutions);
     }
-    fclose(file);
   }
   game_delete(g);
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,457 @@
+/**
+ * @file game_solver.c
+ * @brief Bounded solution counter based on constraint propagation.
+ * @details The grid is cut into row and column segments (maximal runs of non
+ * wall squares, circular with the wrapping option): a light bulb lights its
+ * two segments and no segment can hold two light bulbs. Each square is either
+ * undecided, a light bulb or empty. Assigning a square propagates the wall
+ * numbers and the "every square must be lit" rule, and the search branches on
+ * the unlit square with the fewest candidate light bulbs. Each assignment is
+ * recorded on a trail, so backtracking only undoes what has been changed.
+ * @copyright University of Bordeaux. All rights reserved, 2021.
+ **/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_private.h"
+
+/* ************************************************************************** */
+/*                                DATA TYPES                                  */
+/* ************************************************************************** */
+
+#define NONE ((uint)-1)
+
+enum { UNKNOWN = 0, BULB, EMPTY, WALL };
+
+typedef struct {
+  uint nb_squares;
+  uint nb_segs;
+  unsigned char* cell; /* UNKNOWN, BULB, EMPTY or WALL */
+  uint* seg;           /* row segment (2k) and column segment (2k+1) of square k */
+  uint* seg_start;     /* cells of segment s are seg_cells[seg_start[s] .. seg_start[s+1]] */
+  uint* seg_cells;
+  uint* seg_bulbs;   /* number of light bulbs in each segment */
+  uint* seg_unknown; /* number of undecided squares in each segment */
+  uint nb_walls;
+  uint* wall_cell;   /* square index of each numbered wall */
+  int* wall_number;  /* expected number of light bulbs */
+  uint* wall_neigh;  /* 4 neighbours per wall (with multiplicity), NONE if outside or wall */
+  uint* cell_walls;  /* 4 numbered walls (wall index) per square, NONE otherwise */
+  uint* trail;       /* assigned squares, in assignment order */
+  uint trail_len;
+  uint* todo_walls; /* walls and segments waiting to be checked */
+  uint nb_todo_walls;
+  bool* wall_queued;
+  uint* todo_segs;
+  uint nb_todo_segs;
+  bool* seg_queued;
+  uint limit;
+  uint count;
+  uint nb_guesses;
+  uint budget;          /* maximum number of guesses */
+  bool out_of_budget;   /* the search has been stopped before its end */
+  square* solution;
+  cgame g;
+} solver;
+
+/* ************************************************************************** */
+/*                                  SETUP                                     */
+/* ************************************************************************** */
+
+/* appends the segments of one row (dir = RIGHT) or one column (dir = DOWN) */
+static void _add_line_segments(solver* s, cgame g, uint i, uint j, direction dir, uint axis, uint* nb_cells)
+{
+  uint len = (dir == RIGHT) ? g->nb_cols : g->nb_rows;
+  uint step = (dir == RIGHT) ? 1 : g->nb_cols;
+  uint first = INDEX(g, i, j);
+
+  // with wrapping, a segment can go across the border: start right after a wall
+  uint start = 0;
+  if (g->wrapping)
+    for (uint k = 0; k < len; k++)
+      if (s->cell[first + k * step] == WALL) {
+        start = k + 1;
+        break;
+      }
+
+  bool open = false;
+  for (uint n = 0; n < len; n++) {
+    uint k = (start + n) % len;
+    uint c = first + k * step;
+    if (s->cell[c] == WALL) {
+      open = false;
+      continue;
+    }
+    if (!open) {
+      s->seg_start[s->nb_segs++] = *nb_cells;
+      open = true;
+    }
+    s->seg[2 * c + axis] = s->nb_segs - 1;
+    s->seg_cells[(*nb_cells)++] = c;
+  }
+}
+
+/* ************************************************************************** */
+
+static void _solver_init(solver* s, cgame g, uint limit, uint budget, square* solution)
+{
+  uint n = g->nb_rows * g->nb_cols;
+  s->g = g;
+  s->nb_squares = n;
+  s->limit = limit;
+  s->count = 0;
+  s->nb_guesses = 0;
+  s->budget = budget;
+  s->out_of_budget = false;
+  s->solution = solution;
+
+  s->cell = malloc(n * sizeof(unsigned char));
+  s->seg = malloc(2 * n * sizeof(uint));
+  s->seg_start = malloc((2 * n + 1) * sizeof(uint));
+  s->seg_cells = malloc(2 * n * sizeof(uint));
+  s->cell_walls = malloc(4 * n * sizeof(uint));
+  s->trail = malloc(n * sizeof(uint));
+  assert(s->cell && s->seg && s->seg_start && s->seg_cells && s->cell_walls && s->trail);
+
+  s->nb_walls = 0;
+  for (uint k = 0; k < n; k++) {
+    square st = g->squares[k] & S_MASK;
+    s->cell[k] = (st & S_BLACK) ? WALL : UNKNOWN;
+    if ((st & S_BLACK) && st != S_BLACKU) s->nb_walls++;
+  }
+
+  // segments
+  s->nb_segs = 0;
+  uint nb_cells = 0;
+  for (uint i = 0; i < g->nb_rows; i++) _add_line_segments(s, g, i, 0, RIGHT, 0, &nb_cells);
+  for (uint j = 0; j < g->nb_cols; j++) _add_line_segments(s, g, 0, j, DOWN, 1, &nb_cells);
+  s->seg_start[s->nb_segs] = nb_cells;
+  s->seg_bulbs = calloc(s->nb_segs + 1, sizeof(uint));
+  s->seg_unknown = malloc((s->nb_segs + 1) * sizeof(uint));
+  s->todo_segs = malloc((s->nb_segs + 1) * sizeof(uint));
+  s->seg_queued = calloc(s->nb_segs + 1, sizeof(bool));
+  assert(s->seg_bulbs && s->seg_unknown && s->todo_segs && s->seg_queued);
+  for (uint k = 0; k < s->nb_segs; k++) s->seg_unknown[k] = s->seg_start[k + 1] - s->seg_start[k];
+
+  // numbered walls and their neighbourhood (same semantics as _neigh_count)
+  s->wall_cell = malloc((s->nb_walls + 1) * sizeof(uint));
+  s->wall_number = malloc((s->nb_walls + 1) * sizeof(int));
+  s->wall_neigh = malloc(4 * (s->nb_walls + 1) * sizeof(uint));
+  s->todo_walls = malloc((s->nb_walls + 1) * sizeof(uint));
+  s->wall_queued = calloc(s->nb_walls + 1, sizeof(bool));
+  assert(s->wall_cell && s->wall_number && s->wall_neigh && s->todo_walls && s->wall_queued);
+  for (uint k = 0; k < 4 * n; k++) s->cell_walls[k] = NONE;
+  direction dirs[] = {UP, DOWN, LEFT, RIGHT};
+  uint w = 0;
+  for (uint i = 0; i < g->nb_rows; i++)
+    for (uint j = 0; j < g->nb_cols; j++) {
+      square st = STATE(g, i, j);
+      if (!(st & S_BLACK) || st == S_BLACKU) continue;
+      s->wall_cell[w] = INDEX(g, i, j);
+      s->wall_number[w] = st - S_BLACK;
+      for (uint d = 0; d < 4; d++) {
+        int ii = i, jj = j;
+        uint c = NONE;
+        if (_next(g, &ii, &jj, dirs[d]) && s->cell[INDEX(g, ii, jj)] != WALL) c = INDEX(g, ii, jj);
+        s->wall_neigh[4 * w + d] = c;
+        if (c == NONE) continue;
+        for (uint l = 0; l < 4; l++)
+          if (s->cell_walls[4 * c + l] == NONE || s->cell_walls[4 * c + l] == w) {
+            s->cell_walls[4 * c + l] = w;
+            break;
+          }
+      }
+      w++;
+    }
+
+  s->trail_len = 0;
+  s->nb_todo_walls = 0;
+  s->nb_todo_segs = 0;
+}
+
+/* ************************************************************************** */
+
+static void _solver_free(solver* s)
+{
+  free(s->cell);
+  free(s->seg);
+  free(s->seg_start);
+  free(s->seg_cells);
+  free(s->cell_walls);
+  free(s->trail);
+  free(s->seg_bulbs);
+  free(s->seg_unknown);
+  free(s->todo_segs);
+  free(s->seg_queued);
+  free(s->wall_cell);
+  free(s->wall_number);
+  free(s->wall_neigh);
+  free(s->todo_walls);
+  free(s->wall_queued);
+}
+
+/* ************************************************************************** */
+/*                               PROPAGATION                                  */
+/* ************************************************************************** */
+
+static void _queue_seg(solver* s, uint seg)
+{
+  if (s->seg_queued[seg]) return;
+  s->seg_queued[seg] = true;
+  s->todo_segs[s->nb_todo_segs++] = seg;
+}
+
+/* ************************************************************************** */
+
+static void _queue_wall(solver* s, uint w)
+{
+  if (s->wall_queued[w]) return;
+  s->wall_queued[w] = true;
+  s->todo_walls[s->nb_todo_walls++] = w;
+}
+
+/* ************************************************************************** */
+
+static void _queue_walls(solver* s, uint c)
+{
+  for (uint l = 0; l < 4 && s->cell_walls[4 * c + l] != NONE; l++) _queue_wall(s, s->cell_walls[4 * c + l]);
+}
+
+/* ************************************************************************** */
+
+static void _clear_queues(solver* s)
+{
+  while (s->nb_todo_walls) s->wall_queued[s->todo_walls[--s->nb_todo_walls]] = false;
+  while (s->nb_todo_segs) s->seg_queued[s->todo_segs[--s->nb_todo_segs]] = false;
+}
+
+/* ************************************************************************** */
+
+static bool _is_lit(solver* s, uint c)
+{
+  return s->seg_bulbs[s->seg[2 * c]] + s->seg_bulbs[s->seg[2 * c + 1]] > 0;
+}
+
+/* ************************************************************************** */
+
+/* assigns an undecided square, returns false on a contradiction */
+static bool _assign(solver* s, uint c, unsigned char v)
+{
+  if (s->cell[c] != UNKNOWN) return s->cell[c] == v;
+  uint rs = s->seg[2 * c], cs = s->seg[2 * c + 1];
+  if (v == BULB && (s->seg_bulbs[rs] || s->seg_bulbs[cs])) return false;  // seen by another light bulb
+
+  s->cell[c] = v;
+  s->trail[s->trail_len++] = c;
+  s->seg_unknown[rs]--;
+  s->seg_unknown[cs]--;
+  _queue_walls(s, c);
+  if (v == BULB) {
+    s->seg_bulbs[rs]++;
+    s->seg_bulbs[cs]++;
+    // no other light bulb in the lighted segments
+    for (uint a = 0; a < 2; a++) {
+      uint seg = s->seg[2 * c + a];
+      for (uint k = s->seg_start[seg]; k < s->seg_start[seg + 1]; k++)
+        if (s->cell[s->seg_cells[k]] == UNKNOWN && !_assign(s, s->seg_cells[k], EMPTY)) return false;
+    }
+  } else {
+    _queue_seg(s, rs);
+    _queue_seg(s, cs);
+  }
+  return true;
+}
+
+/* ************************************************************************** */
+
+static void _undo(solver* s, uint mark)
+{
+  while (s->trail_len > mark) {
+    uint c = s->trail[--s->trail_len];
+    uint rs = s->seg[2 * c], cs = s->seg[2 * c + 1];
+    if (s->cell[c] == BULB) {
+      s->seg_bulbs[rs]--;
+      s->seg_bulbs[cs]--;
+    }
+    s->seg_unknown[rs]++;
+    s->seg_unknown[cs]++;
+    s->cell[c] = UNKNOWN;
+  }
+}
+
+/* ************************************************************************** */
+
+/* number of undecided squares that could light square c */
+static uint _nb_candidates(solver* s, uint c)
+{
+  return s->seg_unknown[s->seg[2 * c]] + s->seg_unknown[s->seg[2 * c + 1]] - (s->cell[c] == UNKNOWN);
+}
+
+/* ************************************************************************** */
+
+static uint _first_candidate(solver* s, uint c)
+{
+  if (s->cell[c] == UNKNOWN) return c;
+  for (uint a = 0; a < 2; a++) {
+    uint seg = s->seg[2 * c + a];
+    for (uint k = s->seg_start[seg]; k < s->seg_start[seg + 1]; k++)
+      if (s->cell[s->seg_cells[k]] == UNKNOWN) return s->seg_cells[k];
+  }
+  return NONE;
+}
+
+/* ************************************************************************** */
+
+static bool _check_wall(solver* s, uint w)
+{
+  int bulbs = 0, unknown = 0;
+  for (uint d = 0; d < 4; d++) {
+    uint c = s->wall_neigh[4 * w + d];
+    if (c == NONE) continue;
+    bulbs += (s->cell[c] == BULB);
+    unknown += (s->cell[c] == UNKNOWN);
+  }
+  int expected = s->wall_number[w];
+  if (bulbs > expected || bulbs + unknown < expected) return false;
+  if (unknown == 0 || (bulbs != expected && bulbs + unknown != expected)) return true;
+  unsigned char v = (bulbs == expected) ? EMPTY : BULB;
+  for (uint d = 0; d < 4; d++) {
+    uint c = s->wall_neigh[4 * w + d];
+    if (c != NONE && s->cell[c] == UNKNOWN && !_assign(s, c, v)) return false;
+  }
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* every unlit square of the segment must keep at least one candidate */
+static bool _check_seg(solver* s, uint seg)
+{
+  if (s->seg_bulbs[seg]) return true;
+  for (uint k = s->seg_start[seg]; k < s->seg_start[seg + 1]; k++) {
+    uint c = s->seg_cells[k];
+    if (_is_lit(s, c)) continue;
+    uint nb = _nb_candidates(s, c);
+    if (nb == 0) return false;
+    if (nb == 1 && !_assign(s, _first_candidate(s, c), BULB)) return false;
+  }
+  return true;
+}
+
+/* ************************************************************************** */
+
+static bool _propagate(solver* s)
+{
+  while (s->nb_todo_walls || s->nb_todo_segs) {
+    bool ok;
+    if (s->nb_todo_walls) {
+      uint w = s->todo_walls[--s->nb_todo_walls];
+      s->wall_queued[w] = false;
+      ok = _check_wall(s, w);
+    } else {
+      uint seg = s->todo_segs[--s->nb_todo_segs];
+      s->seg_queued[seg] = false;
+      ok = _check_seg(s, seg);
+    }
+    if (!ok) {
+      _clear_queues(s);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ************************************************************************** */
+/*                                  SEARCH                                    */
+/* ************************************************************************** */
+
+static void _record_solution(solver* s)
+{
+  if (!s->solution) return;
+  for (uint k = 0; k < s->nb_squares; k++) {
+    if (s->cell[k] == WALL)
+      s->solution[k] = s->g->squares[k] & S_MASK;
+    else
+      s->solution[k] = (s->cell[k] == BULB) ? S_LIGHTBULB : S_BLANK;
+  }
+}
+
+/* ************************************************************************** */
+
+static void _search(solver* s)
+{
+  if (s->count >= s->limit || s->out_of_budget) return;
+
+  // branch on the unlit square with the fewest candidates
+  uint best = NONE, best_nb = NONE;
+  for (uint c = 0; c < s->nb_squares && best_nb > 1; c++) {
+    if (s->cell[c] == WALL || _is_lit(s, c)) continue;
+    uint nb = _nb_candidates(s, c);
+    if (nb < best_nb) {
+      best = c;
+      best_nb = nb;
+    }
+  }
+
+  // all squares are lit: a wall with an undecided neighbour can not be left
+  if (best == NONE) {
+    s->count++;
+    _record_solution(s);
+    return;
+  }
+
+  if (s->nb_guesses == s->budget) {
+    s->out_of_budget = true;
+    return;
+  }
+
+  // either the k-th candidate is the light bulb that lights best, or it is empty
+  s->nb_guesses++;
+  uint mark = s->trail_len;
+  while (s->count < s->limit && !s->out_of_budget) {
+    uint c = _first_candidate(s, best);
+    if (c == NONE) break;
+    uint step = s->trail_len;
+    if (_assign(s, c, BULB) && _propagate(s)) _search(s);
+    _clear_queues(s);
+    _undo(s, step);
+    if (!_assign(s, c, EMPTY) || !_propagate(s)) break;
+    if (_is_lit(s, best)) {  // the last candidate has been forced by propagation
+      _search(s);
+      break;
+    }
+  }
+  _clear_queues(s);
+  _undo(s, mark);
+}
+
+/* ************************************************************************** */
+
+uint _solve_count(cgame g, uint limit, uint budget, square* solution, uint* nb_guesses)
+{
+  assert(g);
+  solver s;
+  _solver_init(&s, g, limit, budget, solution);
+
+  // the light bulbs already played are kept, the marked squares can not be light bulbs
+  bool ok = true;
+  for (uint k = 0; k < s.nb_squares && ok; k++) {
+    square st = g->squares[k] & S_MASK;
+    if (st == S_LIGHTBULB) ok = _assign(&s, k, BULB);
+    if (st == S_MARK) ok = _assign(&s, k, EMPTY);
+  }
+  for (uint w = 0; w < s.nb_walls; w++) _queue_wall(&s, w);
+  for (uint seg = 0; seg < s.nb_segs; seg++) _queue_seg(&s, seg);
+
+  if (ok && limit > 0 && _propagate(&s)) _search(&s);
+  if (nb_guesses) *nb_guesses = s.nb_guesses;
+  _solver_free(&s);
+  return s.out_of_budget ? SOLVE_UNKNOWN : s.count;
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,152 @@
+/**
+ * @file game_stress.c
+ * @brief Randomized stress test of the incremental flag updates.
+ * @details Usage: game_stress [-s seed] [nb_operations], plays random moves,
+ * undos, redos, restarts and batches of moves (1000000 operations by default)
+ * on random boards, from 1 x 1 to 12 x 12, with and without wrapping, with any
+ * kind of walls (numbers which can not be satisfied included). After each
+ * operation, the flags are checked against the full recomputation of
+ * game_update_flags() (see _oracle_check()). The first divergence is reported
+ * with the board, the seed and the number of the operation, and the run fails.
+ * The same seed replays the same operations.
+ **/
+
+#define _POSIX_C_SOURCE 200809L  // clock_gettime()
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_private.h"
+#include "game_tools.h"
+
+#define MAX_SIZE 12
+
+/* operations on a board before the next one */
+#define OPERATIONS_PER_BOARD 2000
+
+static const uint densities[] = {0, 10, 25, 50, 80};  // percent of walls
+static const square moves[] = {S_BLANK, S_LIGHTBULB, S_MARK};
+
+/* ************************************************************************** */
+
+static double _now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+
+/* a random board, 1 x n and n x 1 included, with some squares already played */
+static game _board(rng* r)
+{
+  uint nb_rows = 1 + _rng_below(r, MAX_SIZE);
+  uint nb_cols = 1 + _rng_below(r, MAX_SIZE);
+  game g = game_new_empty_ext(nb_rows, nb_cols, _rng_below(r, 2));
+  uint density = densities[_rng_below(r, sizeof(densities) / sizeof(densities[0]))];
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++) {
+      if (_rng_below(r, 100) < density)
+        game_set_square(g, i, j, S_BLACK + _rng_below(r, S_BLACKU - S_BLACK + 1));
+      else if (_rng_below(r, 4) == 0)
+        game_set_square(g, i, j, moves[_rng_below(r, 3)]);
+    }
+  // without this update, the first move has to update all the flags itself
+  if (_rng_below(r, 2)) game_update_flags(g);
+  return g;
+}
+
+/* ************************************************************************** */
+
+/* a random non wall square, false if there is none */
+static bool _square(rng* r, cgame g, uint* pi, uint* pj)
+{
+  for (uint k = 0; k < 16; k++) {
+    *pi = _rng_below(r, game_nb_rows(g));
+    *pj = _rng_below(r, game_nb_cols(g));
+    if (!game_is_black(g, *pi, *pj)) return true;
+  }
+  return false;
+}
+
+/* ************************************************************************** */
+
+/* plays a random operation, returns its name */
+static const char* _operation(rng* r, game g)
+{
+  uint i, j, op = _rng_below(r, 100);
+  if (op < 70) {
+    if (!_square(r, g, &i, &j)) return "none";
+    game_play_move(g, i, j, moves[_rng_below(r, 3)]);
+    return "game_play_move";
+  }
+  if (op < 83) {
+    game_undo(g);
+    return "game_undo";
+  }
+  if (op < 96) {
+    game_redo(g);
+    return "game_redo";
+  }
+  if (op < 98) {
+    game_restart(g);
+    return "game_restart";
+  }
+  uint batch[3 * 8], nb = 0;
+  for (; nb < 8 && _square(r, g, &i, &j); nb++) {
+    batch[3 * nb] = i;
+    batch[3 * nb + 1] = j;
+    batch[3 * nb + 2] = moves[_rng_below(r, 3)];
+  }
+  game_play_moves(g, batch, nb);
+  return "game_play_moves";
+}
+
+/* ************************************************************************** */
+
+int main(int argc, char* argv[])
+{
+  uint64_t seed = 1;
+  unsigned long nb_operations = 1000000;
+  int a = 1;
+  if (a + 1 < argc && argv[a][0] == '-' && argv[a][1] == 's' && argv[a][2] == '\0') {
+    seed = strtoull(argv[a + 1], NULL, 10);
+    a += 2;
+  }
+  if (a < argc) nb_operations = strtoul(argv[a++], NULL, 10);
+  if (a != argc || nb_operations == 0) {
+    fprintf(stderr, "Usage: %s [-s seed] [nb_operations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  rng r;
+  _rng_seed(&r, seed);
+  double start = _now();
+  game g = NULL;
+  unsigned long nb_boards = 0, nb_checks = 0;
+  for (unsigned long k = 0; k < nb_operations; k++) {
+    if (k % OPERATIONS_PER_BOARD == 0) {
+      if (g) game_delete(g);
+      g = _board(&r);
+      nb_boards++;
+    }
+    const char* call = _operation(&r, g);
+    if (g->stale) continue;  // nothing has updated the flags of the new board yet
+    nb_checks++;
+    if (!_oracle_check(g, call)) {
+      fprintf(stderr, "game_stress: operation %lu of seed %llu\n", k, (unsigned long long)seed);
+      game_delete(g);
+      return EXIT_FAILURE;
+    }
+  }
+  game_delete(g);
+  printf("%lu operations on %lu boards in %.1f s: the flags match game_update_flags after %lu of them\n",
+         nb_operations, nb_boards, _now() - start, nb_checks);
+  return EXIT_SUCCESS;
+}
@@ -113,10 +113,21 @@ struct test tests[] = {  // dummy test
 
     /* load & save */
     {"load", test_load},
+    {"load_format", test_load_format},
     {"save", test_save},
+    {"binary", test_binary},
+    {"corpus", test_corpus},
+    {"desc", test_desc},
+    {"save_mem", test_save_mem},
+    {"journal", test_journal},
+    {"play_moves", test_play_moves},
     /* solve & nb_solutions*/
     {"solve", test_game_solve},
     {"solutions", test_game_nb_solutions},
+    /* random */
+    {"random", test_game_random},
+    {"random_seeded", test_game_random_seeded},
+    {"random_unique", test_game_random_unique},
     // end
     {NULL, NULL}};
 
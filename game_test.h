@@ -70,7 +70,17 @@ int test_restart_undo(void);
 /* ************************************************************************** */
 
 int test_load(void);
+int test_load_format(void);
 int test_save(void);
+int test_binary(void);
+int test_corpus(void);
+int test_desc(void);
+int test_save_mem(void);
+int test_journal(void);
+int test_play_moves(void);
 int test_game_solve(void);
 int test_game_nb_solutions(void);
+int test_game_random(void);
+int test_game_random_seeded(void);
+int test_game_random_unique(void);
 #endif  // __GAME_TEST_H__
@@ -6,15 +6,22 @@
  **/
 
 #include <assert.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "game.h"
 #include "game_aux.h"
+#include "game_corpus.h"
 #include "game_examples.h"
 #include "game_ext.h"
+#include "game_journal.h"
+#include "game_private.h"
 #include "game_test.h"
 #include "game_tools.h"
 
@@ -61,11 +68,87 @@ int test_load(void)
 }
 
 /* ************************************************************************** */
+
+/* loads text from a heap buffer of its exact length, without the final '\0' */
+static game _load_text(const char* text)
+{
+  size_t size = strlen(text);
+  char* buf = malloc(size ? size : 1);
+  if (!buf) return NULL;
+  memcpy(buf, text, size);
+  game g = game_load_mem(buf, size);
+  free(buf);
+  return g;
+}
+
+int test_load_format(void)
+{
+  // the same 2x3 game, with extra spaces in the header and with CRLF line ends
+  const char* valid[] = {"2 3 0\n*b1\nw-b\n", "2  3 0 \n*b1\nw-b\nextra", "2 3 0\r\n*b1\r\nw-b\r\n"};
+  square squares[] = {S_LIGHTBULB, S_BLANK, S_BLACK1, S_BLACKU, S_MARK, S_BLANK};
+  game expected = game_new_ext(2, 3, squares, false);
+  game_update_flags(expected);
+  for (uint k = 0; k < sizeof(valid) / sizeof(valid[0]); k++) {
+    game g = _load_text(valid[k]);
+    if (!g || !game_equal(g, expected)) return EXIT_FAILURE;
+    if (!game_is_lighted(g, 0, 1) || game_is_lighted(g, 1, 2)) return EXIT_FAILURE;
+    game_delete(g);
+  }
+  game_delete(expected);
+
+  const char* invalid[] = {
+      "",                          // no header
+      "2 3\n",                     // incomplete header
+      "2 3 2\n*b1\nw-b\n",         // bad wrapping option
+      "0 3 0\n",                   // empty grid
+      "4294967295 4294967295 0\n", // oversized grid, rejected before allocation
+      "99999999999 3 0\n",         // overflow
+      "2 3 0\n*b1\nw-b",           // missing end of line
+      "2 3 0\n*b1\nw-\n\n",        // short row
+      "2 3 0\n*b1\nwxb\n",         // invalid square
+      "2 3 0\n*b1b\nw-\n",         // long row
+      "2 3 0\n*b1\n",              // missing row
+      "3 3 0\n*b1\n*b1\nw-",        // short last row at the end of the buffer
+      "3 3 0\n*b1\r\n*b1\r\nw-",    // same with CRLF rows, which pass the size check
+  };
+  for (uint k = 0; k < sizeof(invalid) / sizeof(invalid[0]); k++) {
+    game g = _load_text(invalid[k]);
+    if (g) {
+      game_delete(g);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+/* number of temporary files (.name.XXXXXX) left by the saves of name */
+static uint _nb_temp_files(const char* name)
+{
+  char prefix[64];
+  snprintf(prefix, sizeof(prefix), ".%s.", name);
+  DIR* dir = opendir(".");
+  if (!dir) return (uint)-1;
+  uint nb = 0;
+  for (struct dirent* e = readdir(dir); e; e = readdir(dir))
+    if (strncmp(e->d_name, prefix, strlen(prefix)) == 0) nb++;
+  closedir(dir);
+  return nb;
+}
+
+/* saves the game 200 times in saveTestWrap.txt */
+static void* _save_loop(void* g)
+{
+  for (uint k = 0; k < 200; k++) game_save(g, "saveTestWrap.txt");
+  return NULL;
+}
+
 int test_save(void)
 {
   game g = game_default();
   game_play_move(g, 0, 0, S_LIGHTBULB);
-  game_save(g, "savetest.txt");
+  if (!game_save(g, "savetest.txt")) return EXIT_FAILURE;
   if (access("savetest.txt", F_OK) != 0) {
     return EXIT_FAILURE;
   }
@@ -87,12 +170,388 @@ int test_save(void)
     return EXIT_FAILURE;
   }
 
+  // atomic save: no temporary file is left, the mode of the file is kept, a
+  // failed save returns false
+  if (chmod("savetest.txt", 0640) != 0) return EXIT_FAILURE;
+  if (!game_save(g, "savetest.txt") || !game_save_sync(gWrap, "saveTestWrap.txt")) return EXIT_FAILURE;
+  if (_nb_temp_files("savetest.txt") != 0 || _nb_temp_files("saveTestWrap.txt") != 0) return EXIT_FAILURE;
+  struct stat st;
+  if (stat("savetest.txt", &st) != 0 || (st.st_mode & 0777) != 0640) return EXIT_FAILURE;
+  if (game_save(g, "noSuchDirectory/savetest.txt")) return EXIT_FAILURE;
+
+  // concurrent saves of the same file: it always holds one of the games
+  pthread_t saver;
+  if (pthread_create(&saver, NULL, _save_loop, gWrap) != 0) return EXIT_FAILURE;
+  bool whole = true;
+  for (uint k = 0; k < 200; k++) {
+    game_save(g, "saveTestWrap.txt");
+    game r = game_load("saveTestWrap.txt");
+    if (!r || (!game_equal(r, g) && !game_equal(r, gWrap))) whole = false;
+    if (r) game_delete(r);
+  }
+  pthread_join(saver, NULL);
+  if (!whole || _nb_temp_files("saveTestWrap.txt") != 0) return EXIT_FAILURE;
+  game_save(gWrap, "saveTestWrap.txt");
+  game_delete(g2);
+  g2 = game_load("saveTestWrap.txt");
+  if (!g2 || !game_equal(gWrap, g2)) return EXIT_FAILURE;
+
   game_delete(g);
   game_delete(g2);
   game_delete(gWrap);
   game_delete(gWrap2);
   return EXIT_SUCCESS;
 }
+/* ************************************************************************** */
+int test_binary(void)
+{
+  game games[4];
+  games[0] = game_default();
+  game_play_move(games[0], 0, 0, S_LIGHTBULB);
+  game_play_move(games[0], 1, 1, S_MARK);
+  games[1] = game_new_ext(5, 3, ext_5x3w_squares, true);
+  games[2] = game_random_seeded(41, 60, true, 300, true, 7);  // odd number of squares
+  games[3] = game_new_empty_ext(100, 100, false);
+  for (uint k = 0; k < 4; k++)
+    for (uint rle = 0; rle < 2; rle++) {
+      if (!game_save_binary(games[k], "binaryTest.bin", rle)) return EXIT_FAILURE;
+      game g = game_load_binary("binaryTest.bin");
+      game g2 = game_load("binaryTest.bin");  // detected as binary
+      if (!g || !g2 || !game_equal(g, games[k]) || !game_equal(g2, games[k])) return EXIT_FAILURE;
+      game_delete(g);
+      game_delete(g2);
+    }
+
+  // nibble packing, and RLE of the blank runs
+  size_t size, size_rle;
+  unsigned char* buf = _binary_encode(games[3], false, &size);
+  free(_binary_encode(games[3], true, &size_rle));
+  if (size != 24 + 5000 || size_rle > 24 + 2000) return EXIT_FAILURE;
+
+  // corrupted data, wrong sizes
+  game g = _binary_decode(buf, size - 1, "truncated");
+  if (g) return EXIT_FAILURE;
+  buf[100] ^= 0x10;
+  g = _binary_decode(buf, size, "corrupted");
+  if (g) return EXIT_FAILURE;
+  buf[100] ^= 0x10;
+  buf[8] = 99;  // nb_rows, also protected by the checksum
+  g = _binary_decode(buf, size, "bad header");
+  if (g) return EXIT_FAILURE;
+  free(buf);
+
+  // unused square codes (3 to 7), with a valid checksum, in both decoding paths
+  for (uint rle = 0; rle < 2; rle++)
+    for (uint code = S_MARK + 1; code < S_BLACK; code++) {
+      buf = _binary_encode(games[0], rle, &size);
+      buf[24] = (buf[24] & 0xF0) | code;  // square (0,0)
+      uint32_t h = _fnv1a(_fnv1a(FNV1A_INIT, buf, 20), buf + 24, size - 24);
+      for (uint b = 0; b < 4; b++) buf[20 + b] = h >> (8 * b);
+      g = _binary_decode(buf, size, "invalid square");
+      free(buf);
+      if (g) return EXIT_FAILURE;
+    }
+
+  for (uint k = 0; k < 4; k++) game_delete(games[k]);
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+int test_save_mem(void)
+{
+  game g = game_default_solution();
+  game_play_move(g, 6, 6, S_MARK);
+  char buf[64];
+  size_t size = game_save_mem(g, NULL, 0);
+  if (size != 6 + 7 * 8) return EXIT_FAILURE;
+  memset(buf, '#', sizeof(buf));
+  if (game_save_mem(g, buf, size - 1) != size || buf[0] != '#') return EXIT_FAILURE;  // nothing written
+  if (game_save_mem(g, buf, sizeof(buf)) != size || memcmp(buf, "7 7 0\n*b1*bbb\n", 14) != 0) return EXIT_FAILURE;
+  game g2 = game_load_mem(buf, size);
+  if (!g2 || !game_equal(g, g2)) return EXIT_FAILURE;
+  game_delete(g2);
+
+  // from a heap buffer of the exact size, not terminated by '\0'
+  char* exact = malloc(size);
+  if (!exact) return EXIT_FAILURE;
+  memcpy(exact, buf, size);
+  g2 = game_load_mem(exact, size);
+  if (!g2 || !game_equal(g, g2)) return EXIT_FAILURE;
+  game_delete(g2);
+  if (game_load_mem(exact, size - 1)) return EXIT_FAILURE;  // last end of line cut
+  free(exact);
+
+  // same content as the file
+  if (!game_save(g, "saveMemTest.txt")) return EXIT_FAILURE;
+  FILE* f = fopen("saveMemTest.txt", "rb");
+  char file[64];
+  size_t n = f ? fread(file, 1, sizeof(file), f) : 0;
+  if (f) fclose(f);
+  remove("saveMemTest.txt");
+  if (n != size || memcmp(file, buf, size) != 0) return EXIT_FAILURE;
+
+  // binary format, detected by game_load_mem
+  game wrap = game_new_ext(5, 3, ext_5x3w_squares, true);
+  for (uint rle = 0; rle < 2; rle++) {
+    size = game_save_binary_mem(wrap, NULL, 0, rle);
+    if (size == 0 || size > sizeof(buf) || game_save_binary_mem(wrap, buf, size, rle) != size) return EXIT_FAILURE;
+    g2 = game_load_mem(buf, size);
+    if (!g2 || !game_equal(wrap, g2)) return EXIT_FAILURE;
+    game_delete(g2);
+    if (game_load_mem(buf, size - 1)) return EXIT_FAILURE;
+  }
+  if (game_load_mem("", 0)) return EXIT_FAILURE;
+  game_delete(wrap);
+  game_delete(g);
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+/* compares two games and their histories, which are walked through and back */
+static bool _same_history(game g1, game g2, uint depth)
+{
+  for (uint k = 0; k < depth; k++) {
+    if (!game_equal(g1, g2)) return false;
+    game_undo(g1);
+    game_undo(g2);
+  }
+  for (uint k = 0; k < 2 * depth; k++) {
+    if (!game_equal(g1, g2)) return false;
+    game_redo(g1);
+    game_redo(g2);
+  }
+  return game_equal(g1, g2);
+}
+
+int test_play_moves(void)
+{
+  game g = game_default();
+  game_play_move(g, 0, 0, S_LIGHTBULB);
+  game_undo(g);  // cleared by the moves
+  game g2 = game_copy(g);
+  // the fourth move is on a wall: it stops the list
+  uint moves[] = {0, 0, S_LIGHTBULB, 1, 1, S_MARK, 0, 0, S_BLANK, 0, 2, S_LIGHTBULB, 6, 6, S_LIGHTBULB};
+  if (game_play_moves(g, moves, 5) != 3) return EXIT_FAILURE;
+  for (uint k = 0; k < 3; k++) game_play_move(g2, moves[3 * k], moves[3 * k + 1], moves[3 * k + 2]);
+  if (!game_equal(g, g2)) return EXIT_FAILURE;
+  // each move is undone on its own
+  for (uint k = 0; k < 4; k++) {
+    game_undo(g);
+    game_undo(g2);
+    if (!game_equal(g, g2)) return EXIT_FAILURE;
+  }
+  game_redo(g);
+  if (game_get_state(g, 0, 0) != S_LIGHTBULB || !game_is_lighted(g, 0, 1)) return EXIT_FAILURE;
+  if (game_play_moves(g, moves + 9, 1) != 0 || game_play_moves(g, NULL, 0) != 0) return EXIT_FAILURE;
+  game_delete(g);
+  game_delete(g2);
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+int test_journal(void)
+{
+  game g = game_default();
+  if (!game_journal_start(g, "journalTest.lpj")) return EXIT_FAILURE;
+  game_play_move(g, 0, 0, S_LIGHTBULB);
+  game_play_move(g, 1, 1, S_MARK);
+  game_restart(g);
+  game_play_move(g, 2, 2, S_LIGHTBULB);
+  game_play_move(g, 0, 3, S_LIGHTBULB);
+  game_play_move(g, 6, 6, S_MARK);
+  game_undo(g);
+  game_undo(g);
+  game_redo(g);
+
+  // the journal is up to date after each move: the program may die here
+  game_journal_stop(g);
+  game r = game_journal_resume("journalTest.lpj");
+  if (!r || !_same_history(g, r, 4)) return EXIT_FAILURE;
+  game_delete(r);
+
+  // long session: the log is compacted, and the file stays within a snapshot
+  // (at most 24 + 24 + 40 * 40 / 2 + 20 * 10 bytes) and the log that follows it
+  game big = game_new_empty_ext(40, 40, false);
+  if (!game_journal_start(big, "journalBig.lpj")) return EXIT_FAILURE;
+  for (uint k = 0; k < 4000; k++) {
+    game_play_move(big, (k * 7) % 40, (k * 13) % 40, (k % 3 == 0) ? S_MARK : S_LIGHTBULB);
+    if (k % 10 == 9) game_undo(big);
+    if (k % 20 == 19) game_restart(big);
+  }
+  game_journal_stop(big);
+  FILE* f = fopen("journalBig.lpj", "rb");
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fclose(f);
+  if (size > 24 + 24 + 40 * 40 / 2 + 20 * 10 + 4096 + 16) return EXIT_FAILURE;
+  r = game_journal_resume("journalBig.lpj");
+  if (!r || !_same_history(big, r, 20)) return EXIT_FAILURE;
+  game_delete(r);
+  game_delete(big);
+
+  // an interrupted last record is dropped, and the journal goes on after it
+  f = fopen("journalTest.lpj", "ab");
+  fputc(J_PLAY | (S_LIGHTBULB << 4), f);
+  fclose(f);
+  r = game_journal_resume("journalTest.lpj");
+  if (!r || !game_equal(g, r)) return EXIT_FAILURE;
+  game_play_move(r, 1, 6, S_LIGHTBULB);
+  game_play_move(g, 1, 6, S_LIGHTBULB);
+  game_delete(r);  // stops the journal
+  r = game_journal_resume("journalTest.lpj");
+  if (!r || !_same_history(g, r, 5)) return EXIT_FAILURE;
+  game_delete(r);
+
+  // game_solve writes the solution without moves
+  game s = game_default();
+  game_play_move(s, 0, 0, S_MARK);
+  if (!game_journal_start(s, "journalSolve.lpj") || !game_solve(s)) return EXIT_FAILURE;
+  game_journal_stop(s);
+  r = game_journal_resume("journalSolve.lpj");
+  if (!r || !game_equal(s, r) || !game_is_over(r)) return EXIT_FAILURE;
+  game_delete(r);
+  game_delete(s);
+  remove("journalSolve.lpj");
+
+  if (game_journal_resume("badSave.txt") || game_journal_resume("noSuchJournal.lpj")) return EXIT_FAILURE;
+  game_delete(g);
+  remove("journalTest.lpj");
+  remove("journalBig.lpj");
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+int test_desc(void)
+{
+  // the Tatham game ID of the default game, solution and parameters ignored
+  game def = game_default_solution();
+  char buf[7 * 7 + 24];
+  if (!game_to_desc(def, buf, sizeof(buf)) || strcmp(buf, "7x7:b1f2iB2g1Bi2fBb") != 0) return EXIT_FAILURE;
+  if (game_to_desc(def, buf, 19) || !game_to_desc(def, buf, 20)) return EXIT_FAILURE;
+  game_delete(def);
+  def = game_default();
+  game g = game_from_desc("7x7:b1f2iB2g1Bi2fBb");
+  game g2 = game_from_desc("7x7b20s2d0:b1f2iB2g1Bi2fBb");
+  if (!g || !g2 || !game_equal(g, def) || !game_equal(g2, def)) return EXIT_FAILURE;
+  game_delete(g);
+  game_delete(g2);
+
+  // round trip of non-square games, with runs longer than 26 squares
+  game games[2] = {game_random_seeded(13, 40, false, 30, false, 3), game_new_empty_ext(30, 2, false)};
+  for (uint k = 0; k < 2; k++) {
+    size_t size = game_nb_rows(games[k]) * game_nb_cols(games[k]) + 24;
+    char* desc = malloc(size);
+    assert(desc);
+    if (!game_to_desc(games[k], desc, size)) return EXIT_FAILURE;
+    if (k == 1 && strcmp(desc, "2x30:zzh") != 0) return EXIT_FAILURE;
+    g = game_from_desc(desc);
+    if (!g || !game_equal(g, games[k])) return EXIT_FAILURE;
+    game_delete(g);
+    free(desc);
+    game_delete(games[k]);
+  }
+
+  // invalid descriptions, and wrapping games
+  char* bad[] = {"", "7x7", "7x:b", "0x7:g", "7x7:b1f2iB2g1Bi2fBbb", "7x7:b1f2iB2g1Bi2fB", "7x7:b1f2iB2g5Bi2fBb",
+                 "99999x99999:a"};
+  for (uint k = 0; k < sizeof(bad) / sizeof(bad[0]); k++)
+    if (game_from_desc(bad[k])) return EXIT_FAILURE;
+  g = game_new_ext(5, 3, ext_5x3w_squares, true);
+  if (game_to_desc(g, buf, sizeof(buf))) return EXIT_FAILURE;
+  game_delete(g);
+  game_delete(def);
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
+/* copies the first size bytes of a file, as if its writer had died there */
+static bool _copy_prefix(char* from, char* to, long size)
+{
+  FILE* f = fopen(from, "rb");
+  if (!f) return false;
+  char* buf = malloc(size);
+  assert(buf);
+  bool ok = fread(buf, 1, size, f) == (size_t)size;
+  fclose(f);
+  f = fopen(to, "wb");
+  ok = ok && f && fwrite(buf, 1, size, f) == (size_t)size;
+  if (f) fclose(f);
+  free(buf);
+  return ok;
+}
+
+int test_corpus(void)
+{
+  game games[3];
+  games[0] = game_default();
+  games[1] = game_new_ext(5, 3, ext_5x3w_squares, true);
+  games[2] = game_random_seeded(20, 30, false, 100, true, 7);
+  remove("corpusTest.lpc");
+
+  // text and binary records, appended in two sessions
+  corpus c = corpus_open("corpusTest.lpc", true);
+  if (!c || corpus_size(c) != 0) return EXIT_FAILURE;
+  for (uint k = 0; k < 4; k++) {
+    corpus_meta meta = {.seed = 100 + k, .nb_solutions = k, .difficulty = CORPUS_UNKNOWN};
+    if (!corpus_append(c, games[k % 3], &meta, k % 2)) return EXIT_FAILURE;
+  }
+  if (corpus_size(c) != 4 || !corpus_close(c)) return EXIT_FAILURE;
+  c = corpus_open("corpusTest.lpc", true);
+  corpus_meta meta = {.seed = 104, .nb_solutions = 1, .difficulty = 5};
+  if (!c || corpus_size(c) != 4 || !corpus_append(c, games[1], &meta, true) || !corpus_close(c)) return EXIT_FAILURE;
+
+  // random access
+  c = corpus_open("corpusTest.lpc", false);
+  if (!c || corpus_size(c) != 5 || corpus_append(c, games[0], &meta, true)) return EXIT_FAILURE;
+  uint order[] = {4, 0, 2, 3, 1};
+  for (uint k = 0; k < 5; k++) {
+    uint i = order[k];
+    game g = corpus_get(c, i, &meta);
+    if (!g || !game_equal(g, games[i == 4 ? 1 : i % 3]) || meta.seed != 100 + i) return EXIT_FAILURE;
+    if (meta.nb_solutions != (i == 4 ? 1 : i) || meta.difficulty != (i == 4 ? 5 : CORPUS_UNKNOWN)) return EXIT_FAILURE;
+    game_delete(g);
+  }
+  if (corpus_get(c, 5, NULL)) return EXIT_FAILURE;
+  corpus_close(c);
+
+  // sequential reading
+  corpus_reader r = corpus_reader_open("corpusTest.lpc");
+  if (!r) return EXIT_FAILURE;
+  for (uint i = 0; i < 5; i++) {
+    game g = corpus_reader_next(r, &meta);
+    if (!g || !game_equal(g, games[i == 4 ? 1 : i % 3]) || meta.seed != 100 + i) return EXIT_FAILURE;
+    game_delete(g);
+  }
+  if (corpus_reader_next(r, NULL)) return EXIT_FAILURE;
+  corpus_reader_close(r);
+
+  // without its index (8 bytes per offset and the footer), the corpus is
+  // scanned again, and an interrupted last record is dropped
+  FILE* f = fopen("corpusTest.lpc", "rb");
+  fseek(f, 0, SEEK_END);
+  long records_end = ftell(f) - 5 * 8 - 24;
+  fclose(f);
+  for (uint cut = 0; cut < 2; cut++) {
+    if (!_copy_prefix("corpusTest.lpc", "corpusCut.lpc", records_end - cut * 10)) return EXIT_FAILURE;
+    c = corpus_open("corpusCut.lpc", false);
+    if (!c || corpus_size(c) != 5 - cut) return EXIT_FAILURE;
+    game g = corpus_get(c, 3, NULL);
+    if (!g || !game_equal(g, games[0])) return EXIT_FAILURE;
+    game_delete(g);
+    corpus_close(c);
+  }
+  remove("corpusTest.lpc");
+  remove("corpusCut.lpc");
+
+  for (uint k = 0; k < 3; k++) game_delete(games[k]);
+  return EXIT_SUCCESS;
+}
+
 /* ************************************************************************** */
 int test_game_solve(void)
 {
@@ -114,10 +573,15 @@ int test_game_solve(void)
   }
 
   game no_sol = game_new_ext(7, 7, ext_7x7w_sqaures, true);
+  game_play_move(no_sol, 0, 0, S_MARK);
+  game before = game_copy(no_sol);
   bool nosol = game_solve(no_sol);
   if (game_is_over(no_sol) || nosol) {
     return EXIT_FAILURE;
   }
+  // unchanged when there is no solution
+  if (!game_equal(no_sol, before)) return EXIT_FAILURE;
+  game_delete(before);
 
   game_delete(g);
   game_delete(x3);
@@ -149,9 +613,123 @@ int test_game_nb_solutions(void)
   if (solution != 0) {
     return EXIT_FAILURE;
   }
+
+  // the light bulbs already played are kept
+  game_play_move(g, 0, 0, S_LIGHTBULB);  // in the solution
+  if (game_nb_solutions(g) != 1) return EXIT_FAILURE;
+  game_play_move(g, 0, 0, S_BLANK);
+  game_play_move(g, 0, 1, S_LIGHTBULB);  // not in the solution
+  if (game_nb_solutions(g) != 0) return EXIT_FAILURE;
+  square squares[] = {S_BLACK0, S_BLANK, S_BLACK1, S_BLACKU, S_BLANK, S_BLANK, S_BLANK, S_BLANK, S_BLANK};
+  game x3b = game_new_ext(3, 3, squares, false);
+  if (game_nb_solutions(x3b) != 1) return EXIT_FAILURE;
+  game_play_move(x3b, 0, 1, S_LIGHTBULB);  // next to the 0 wall
+  if (game_nb_solutions(x3b) != 0) return EXIT_FAILURE;
+  game_delete(x3b);
   game_delete(g);
   game_delete(x3);
   game_delete(wrap);
   game_delete(no_sol);
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+/* ************************************************************************** */
+int test_game_random(void)
+{
+  uint sizes[][3] = {{7, 7, 10}, {5, 3, 0}, {1, 8, 2}, {3, 10, 30}, {40, 60, 800}};
+  for (uint k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    for (uint wrapping = 0; wrapping < 2; wrapping++) {
+      uint nb_rows = sizes[k][0], nb_cols = sizes[k][1], nb_walls = sizes[k][2];
+      game g = game_random(nb_rows, nb_cols, wrapping, nb_walls, true);
+      if (game_nb_rows(g) != nb_rows || game_nb_cols(g) != nb_cols || game_is_wrapping(g) != wrapping) {
+        return EXIT_FAILURE;
+      }
+      uint walls = 0;
+      for (uint i = 0; i < nb_rows; i++)
+        for (uint j = 0; j < nb_cols; j++) walls += game_is_black(g, i, j);
+      if (walls != nb_walls || !game_is_over(g)) return EXIT_FAILURE;
+
+      // without solution, only the walls remain
+      game g2 = game_random(nb_rows, nb_cols, wrapping, nb_walls, false);
+      for (uint i = 0; i < nb_rows; i++)
+        for (uint j = 0; j < nb_cols; j++)
+          if (!game_is_black(g2, i, j) && game_get_square(g2, i, j) != S_BLANK) return EXIT_FAILURE;
+      game_delete(g);
+      game_delete(g2);
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+int test_game_random_seeded(void)
+{
+  // reference xoshiro256** output for splitmix64(12345): same numbers everywhere
+  rng r;
+  _rng_seed(&r, 12345);
+  uint64_t expected[] = {0xbe6a36374160d49bULL, 0x214aaa0637a688c6ULL, 0xf69d16de9954d388ULL};
+  for (uint k = 0; k < 3; k++)
+    if (_rng_next(&r) != expected[k]) return EXIT_FAILURE;
+  for (uint k = 0; k < 1000; k++)
+    if (_rng_below(&r, 7) >= 7 || _rng_below(&r, 1) != 0) return EXIT_FAILURE;
+
+  for (uint64_t seed = 0; seed < 20; seed++) {
+    // the global state of rand() is left untouched
+    srand(3);
+    int next = rand();
+    srand(3);
+    game g = game_random_seeded(8, 6, seed % 2, 12, true, seed);
+    game g2 = game_random_seeded(8, 6, seed % 2, 12, true, seed);
+    if (rand() != next) return EXIT_FAILURE;
+    if (!game_equal(g, g2) || !game_is_over(g)) return EXIT_FAILURE;
+    game_delete(g2);
+    g2 = game_random_seeded(8, 6, seed % 2, 12, true, seed + 1000);
+    bool same = game_equal(g, g2);
+    game_delete(g);
+    game_delete(g2);
+    if (same) return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+int test_game_random_unique(void)
+{
+  for (uint64_t seed = 1; seed <= 10; seed++) {
+    uint nb_attempts = 0;
+    game g = game_random_unique(7, 7, seed % 2, 10, seed, &nb_attempts);
+    if (!g || nb_attempts < 1 || nb_attempts > RANDOM_UNIQUE_ATTEMPTS) return EXIT_FAILURE;
+    if (game_nb_solutions(g) != 1) return EXIT_FAILURE;
+
+    // same seed, same game
+    game g2 = game_random_unique(7, 7, seed % 2, 10, seed, NULL);
+    if (!g2 || !game_equal(g, g2)) return EXIT_FAILURE;
+
+    // minimal clue set: each wall number is needed
+    for (uint i = 0; i < 7; i++)
+      for (uint j = 0; j < 7; j++) {
+        if (!game_is_black(g, i, j) || game_get_black_number(g, i, j) == -1) continue;
+        square s = game_get_square(g, i, j);
+        game_set_square(g, i, j, S_BLACKU);
+        if (_solve_count(g, 2, (uint)-1, NULL, NULL) == 1) return EXIT_FAILURE;
+        game_set_square(g, i, j, s);
+      }
+    game_delete(g);
+    game_delete(g2);
+  }
+
+  // the search budget bounds the time spent on a large board
+  for (uint64_t seed = 1; seed <= 2; seed++) {
+    clock_t start = clock();
+    game g = game_random_unique(30, 30, false, 180, seed, NULL);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    if (!g || seconds > 30) return EXIT_FAILURE;
+    if (game_nb_solutions(g) != 1) return EXIT_FAILURE;
+    game_delete(g);
+  }
+
+  // an open 2x2 board always has 2 solutions
+  uint nb_attempts = 0;
+  if (game_random_unique(2, 2, false, 0, 1, &nb_attempts) != NULL) return EXIT_FAILURE;
+  if (nb_attempts != RANDOM_UNIQUE_ATTEMPTS) return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
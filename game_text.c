@@ -69,7 +69,7 @@ static bool game_step(game g)
     if (scanf("%s", filename) == 0) {
       printf("empty string scanned\n");
     }
-    game_save(g, filename);
+    if (game_save(g, filename)) printf("game saved in %s\n", filename);
 
   } else if (c == 'z') {  // undo
     printf("> action: undo\n");
@@ -120,11 +120,16 @@ int main(int argc, char* argv[])
   game g = NULL;
   if (argc == 2)
     g = game_load(argv[1]);
-  else{
-    srand(time(NULL));  // initialize radom seed with current time
-    g = game_random(7, 7, false, 10, false);
+  else if (argc == 3 && strcmp(argv[1], "-d") == 0)  // a Tatham description, such as "7x7:b1f2iB2g1Bi2fBb"
+    g = game_from_desc(argv[2]);
+  else {
+    // "game_text -s <seed>" plays the game of a given seed again
+    uint64_t seed = (uint64_t)time(NULL);
+    if (argc == 3 && strcmp(argv[1], "-s") == 0) seed = strtoull(argv[2], NULL, 10);
+    printf("seed: %llu\n", (unsigned long long)seed);
+    g = game_random_seeded(7, 7, false, 10, false, seed);
   }
-  assert(g);
+  if (g == NULL) return EXIT_FAILURE;
 
   game_print(g);
   bool win = game_is_over(g);
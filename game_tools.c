@@ -3,15 +3,22 @@
  * @copyright University of Bordeaux. All rights reserved, 2021.
  **/
 
+#define _POSIX_C_SOURCE 200809L  // fsync(), mkstemp(), fchmod()
+
 #include "game_tools.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "game.h"
 #include "game_ext.h"
+#include "game_journal.h"
 #include "game_private.h"
 #include "queue.h"
 
@@ -22,119 +29,678 @@
 /*                                 GAME TOOLS                                   */
 /* ************************************************************************** */
 
-game game_load(char* filename)
-{
-  unsigned char c;
+/* table-driven decoder of the save file characters: square state + 1, 0 if invalid */
+static const unsigned char load_table[256] = {
+    ['b'] = S_BLANK + 1,  ['*'] = S_LIGHTBULB + 1, ['-'] = S_MARK + 1,   ['0'] = S_BLACK0 + 1, ['1'] = S_BLACK1 + 1,
+    ['2'] = S_BLACK2 + 1, ['3'] = S_BLACK3 + 1,    ['4'] = S_BLACK4 + 1, ['w'] = S_BLACKU + 1};
 
-  FILE* saveFile = fopen(filename, "r");
-  if (saveFile == NULL) {
+/* ************************************************************************** */
+
+char* _read_file(char* filename, size_t* size)
+{
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL) {
     fprintf(stderr, "No file named %s\n", filename);
     return NULL;
   }
+  char* buf = NULL;
+  long len = -1;
+  if (fseek(file, 0, SEEK_END) == 0) len = ftell(file);
+  if (len >= 0 && fseek(file, 0, SEEK_SET) == 0) buf = malloc(len + 1);
+  if (buf && fread(buf, 1, len, file) != (size_t)len) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(file);
+  if (buf == NULL) {
+    fprintf(stderr, "%s: read error\n", filename);
+    return NULL;
+  }
+  buf[len] = '\0';
+  *size = len;
+  return buf;
+}
+
+/* ************************************************************************** */
+
+typedef struct {
+  const char* name;
+  const char* p;   /* current character */
+  const char* end;
+  uint line;       /* position of p, from 1 */
+  const char* line_start;
+} reader;
+
+static void _load_error(reader* r, const char* p, const char* msg)
+{
+  fprintf(stderr, "%s:%u:%u: invalid file format: %s\n", r->name, r->line, (uint)(p - r->line_start) + 1, msg);
+}
+
+/* ************************************************************************** */
+
+static void _skip_spaces(reader* r)
+{
+  for (; r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n'); r->p++)
+    if (*r->p == '\n') {
+      r->line++;
+      r->line_start = r->p + 1;
+    }
+}
+
+/* ************************************************************************** */
+
+static bool _read_uint(reader* r, uint* value, const char* what)
+{
+  _skip_spaces(r);
+  uint64_t v = 0;
+  const char* start = r->p;
+  while (r->p < r->end && *r->p >= '0' && *r->p <= '9') {
+    v = v * 10 + (*r->p++ - '0');
+    if (v > (uint)-1) {
+      _load_error(r, start, what);
+      return false;
+    }
+  }
+  if (r->p == start) {
+    _load_error(r, start, what);
+    return false;
+  }
+  *value = (uint)v;
+  return true;
+}
+
+/* ************************************************************************** */
+
+game _text_decode(const char* buf, size_t size, const char* name)
+{
+  reader r = {name, buf, buf + size, 1, buf};
+
+  // header: "<nb_rows> <nb_cols> <wrapping>", then one line of squares per row
   uint rows, columns, wrapping;
-  if (fscanf(saveFile, "%d %d %d ", &rows, &columns, &wrapping) != 3) {
-    fclose(saveFile);
-    fprintf(stderr, "Invalid file format\n");
+  if (!_read_uint(&r, &rows, "expected a number of rows") || !_read_uint(&r, &columns, "expected a number of columns") ||
+      !_read_uint(&r, &wrapping, "expected the wrapping option (0 or 1)"))
+    return NULL;
+  const char* bad = NULL;
+  if (wrapping > 1) bad = "the wrapping option must be 0 or 1";
+  if (rows == 0 || columns == 0) bad = "empty grid";
+  _skip_spaces(&r);
+  // checked before any allocation: each row takes at least columns + 1 bytes
+  if (!bad && (uint64_t)rows * columns > (uint)-1) bad = "grid too large";
+  if (!bad && (uint64_t)rows * (columns + 1ULL) > (uint64_t)(r.end - r.p)) bad = "file too short for the grid size";
+  if (bad) {
+    _load_error(&r, r.p, bad);
     return NULL;
   }
+
   game g = game_new_empty_ext(rows, columns, wrapping);
-  int charScanned = 0;
-
-  for (uint i = 0; i < rows; i++) {
-    for (uint j = 0; j < columns; j++) {
-      charScanned = fscanf(saveFile, "%c", &c);
-      int s = _str2square(c);
-      if (s == -1 || charScanned != 1) {
-        game_delete(g);
-        fclose(saveFile);
-        fprintf(stderr, "Invalid file format\n");
-        return NULL;
-      }
-      game_set_square(g, i, j, s);
+  square* dst = g->squares;
+  for (uint i = 0; i < rows; i++, dst += columns) {
+    // the buffer may end anywhere: CRLF rows make the size check above optimistic
+    const char* p = r.p;
+    uint j = 0;
+    for (; j < columns && p + j < r.end; j++) {
+      unsigned char s = load_table[(unsigned char)p[j]];
+      if (s == 0) break;
+      dst[j] = s - 1;
     }
-    charScanned = fscanf(saveFile, "%c", &c);
-    if (c != '\n' || charScanned != 1) {
+    p += j;
+    if (j < columns)
+      bad = (p == r.end || *p == '\n' || *p == '\r') ? "row too short" : "invalid square character";
+    else if (p < r.end && *p == '\r')
+      p++;
+    if (!bad && p < r.end && *p == '\n')
+      p++;
+    else if (!bad)
+      bad = (p == r.end) ? "missing end of line" : "row too long";
+    if (bad) {
+      _load_error(&r, p, bad);
       game_delete(g);
-      fclose(saveFile);
-      fprintf(stderr, "Invalid file format\n");
       return NULL;
     }
+    r.p = r.line_start = p;
+    r.line++;
   }
-  fclose(saveFile);
   game_update_flags(g);
   return g;
 }
 
+/* ************************************************************************** */
+
+/* decodes a save file of any format, name is used in the error messages */
+static game _decode(const char* buf, size_t size, const char* name)
+{
+  if (_is_binary(buf, size))  // a text file starts with a digit
+    return _binary_decode((const unsigned char*)buf, size, name);
+  return _text_decode(buf, size, name);
+}
+
+/* ************************************************************************** */
+
+game game_load_mem(const char* buf, size_t len)
+{
+  assert(buf || len == 0);
+  return _decode(buf, len, "<memory>");
+}
+
+/* ************************************************************************** */
+
+game game_load(char* filename)
+{
+  size_t size;
+  char* buf = _read_file(filename, &size);
+  if (buf == NULL) return NULL;
+  game g = _decode(buf, size, filename);
+  free(buf);
+  return g;
+}
+
 /********************************************************************************/
 
 static char image_state[255] = {
     [S_BLANK] = 'b', [S_BLACK] = '0', '1', '2', '3', '4', [S_BLACKU] = 'w', [S_LIGHTBULB] = '*', [S_MARK] = '-'};
-void game_save(cgame g, char* filename)
+
+/* ************************************************************************** */
+
+size_t game_save_mem(cgame g, char* buf, size_t cap)
+{
+  assert(g && (buf || cap == 0));
+  char header[64];
+  int len = snprintf(header, sizeof(header), "%u %u %d\n", g->nb_rows, g->nb_cols, game_is_wrapping(g) ? 1 : 0);
+  size_t size = len + (size_t)g->nb_rows * (g->nb_cols + 1);
+  if (size > cap) return size;
+  memcpy(buf, header, len);
+  char* p = buf + len;
+  const square* src = g->squares;
+  for (uint i = 0; i < g->nb_rows; i++) {
+    for (uint j = 0; j < g->nb_cols; j++) *p++ = image_state[*src++ & S_MASK];
+    *p++ = '\n';
+  }
+  return size;
+}
+
+/* ************************************************************************** */
+
+char* _text_encode(cgame g, size_t* size)
+{
+  *size = game_save_mem(g, NULL, 0);
+  char* buf = malloc(*size);
+  if (buf != NULL) game_save_mem(g, buf, *size);
+  return buf;
+}
+
+/* ************************************************************************** */
+
+/* flushes the directory entry of a file, so that a rename survives a crash */
+static bool _sync_dir(const char* filename)
+{
+  const char* slash = strrchr(filename, '/');
+  char* dir = slash ? strndup(filename, slash - filename + 1) : strdup(".");
+  if (dir == NULL) return false;
+  int fd = open(dir, O_RDONLY);
+  free(dir);
+  if (fd < 0) return false;
+  bool ok = (fsync(fd) == 0);
+  close(fd);
+  return ok;
+}
+
+/* ************************************************************************** */
+
+/* readers see either the old file or the new one, never a truncated one */
+bool _write_atomic(char* filename, const void* buf, size_t size, bool sync)
 {
-  assert(g);
   assert(filename);
-  FILE* file = fopen(filename, "w");
-  fprintf(file, "%d %d ", g->nb_rows, g->nb_cols);
-  if (game_is_wrapping(g)) {
-    fprintf(file, "%d\n", 1);
-  } else {
-    fprintf(file, "%d\n", 0);
+  // a temporary file of its own in the target directory: concurrent saves of
+  // the same file do not write into each other's temporary file
+  const char* slash = strrchr(filename, '/');
+  const char* name = slash ? slash + 1 : filename;
+  size_t tmp_len = strlen(filename) + 9;  // '.' + ".XXXXXX" + '\0'
+  char* tmp = malloc(tmp_len);
+  bool ok = false;
+  if (tmp != NULL) {
+    snprintf(tmp, tmp_len, "%.*s.%s.XXXXXX", (int)(name - filename), filename, name);
+    int fd = mkstemp(tmp);
+    FILE* file = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if (fd >= 0 && file == NULL) {
+      close(fd);
+      remove(tmp);
+    }
+    if (file != NULL) {
+      // mkstemp() gives the file to its owner only: keep the mode of the target
+      struct stat st;
+      ok = (fchmod(fd, stat(filename, &st) == 0 ? (st.st_mode & 07777) : 0644) == 0);
+      setvbuf(file, NULL, _IONBF, 0);  // the buffer is written with a single write
+      ok = ok && (fwrite(buf, 1, size, file) == size);
+      if (ok && sync) ok = (fsync(fd) == 0);
+      ok = (fclose(file) == 0) && ok;
+      ok = ok && (rename(tmp, filename) == 0);
+      if (ok && sync) ok = _sync_dir(filename);
+      if (!ok) remove(tmp);
+    }
+    free(tmp);
   }
-  for (uint i = 0; i < g->nb_rows; i++) {
-    for (uint j = 0; j < g->nb_cols; j++) {
-      fprintf(file, "%c", image_state[game_get_state(g, i, j)]);
+  if (!ok) fprintf(stderr, "Cannot save the game in %s\n", filename);
+  return ok;
+}
+
+/* ************************************************************************** */
+
+static bool _save(cgame g, char* filename, bool sync)
+{
+  assert(g);
+  size_t size;
+  char* buf = _text_encode(g, &size);
+  if (buf == NULL) {
+    fprintf(stderr, "%s: out of memory\n", filename);
+    return false;
+  }
+  bool ok = _write_atomic(filename, buf, size, sync);
+  free(buf);
+  return ok;
+}
+
+/* ************************************************************************** */
+
+bool game_save(cgame g, char* filename) { return _save(g, filename, false); }
+
+/* ************************************************************************** */
+
+bool game_save_sync(cgame g, char* filename) { return _save(g, filename, true); }
+
+/* ************************************************************************** */
+/*                               BINARY FORMAT                                */
+/* ************************************************************************** */
+
+/* Header (little endian), followed by the payload:
+ *   0  magic "LUPB"       12  nb_cols
+ *   4  version            16  payload size, in bytes
+ *   5  options            20  FNV-1a checksum of bytes 0..19 and of the payload
+ *   6  reserved (0)
+ *   8  nb_rows
+ * The payload is a stream of 4-bit codes, two per byte (low half first): a
+ * valid square state (see binary_square), or with the RLE option BINARY_RUN followed by a run
+ * length of blank squares, minus BINARY_RUN_MIN, written in 3-bit groups (low
+ * group first, bit 3 set when another group follows). Without RLE, square k
+ * is simply code k, so that a mapped file can be read in place. */
+
+#define BINARY_HEADER_SIZE 24
+#define BINARY_VERSION 1
+#define BINARY_WRAPPING 0x1
+#define BINARY_RLE 0x2
+#define BINARY_RUN 0xF
+#define BINARY_RUN_MIN 4
+
+/* the codes of the square states, 3 to 7 are not used */
+static const bool binary_square[16] = {[S_BLANK] = true, [S_LIGHTBULB] = true, [S_MARK] = true,
+                                       [S_BLACK0] = true, [S_BLACK1] = true, [S_BLACK2] = true,
+                                       [S_BLACK3] = true, [S_BLACK4] = true, [S_BLACKU] = true};
+
+/* ************************************************************************** */
+
+static void _put_u32(unsigned char* p, uint32_t v)
+{
+  for (uint k = 0; k < 4; k++) p[k] = (v >> (8 * k)) & 0xFF;
+}
+
+static uint32_t _get_u32(const unsigned char* p)
+{
+  return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* ************************************************************************** */
+
+uint32_t _fnv1a(uint32_t h, const void* buf, size_t size)
+{
+  const unsigned char* p = buf;
+  for (size_t k = 0; k < size; k++) h = (h ^ p[k]) * 16777619u;
+  return h;
+}
+
+/* ************************************************************************** */
+
+/* appends a 4-bit code to a nibble stream */
+static void _put_nibble(unsigned char* buf, size_t* n, uint v)
+{
+  if (*n % 2 == 0)
+    buf[*n / 2] = v;
+  else
+    buf[*n / 2] |= v << 4;
+  (*n)++;
+}
+
+/* ************************************************************************** */
+
+unsigned char* _binary_encode(cgame g, bool rle, size_t* size)
+{
+  assert(g);
+  size_t nb_squares = (size_t)g->nb_rows * g->nb_cols;
+  // one code per square at most: a run never takes more codes than its squares
+  unsigned char* buf = malloc(BINARY_HEADER_SIZE + nb_squares / 2 + 1);
+  if (buf == NULL) return NULL;
+  unsigned char* payload = buf + BINARY_HEADER_SIZE;
+  size_t n = 0;
+  for (size_t k = 0; k < nb_squares;) {
+    square s = g->squares[k] & S_MASK;
+    size_t run = 1;
+    if (rle && s == S_BLANK)
+      while (k + run < nb_squares && (g->squares[k + run] & S_MASK) == S_BLANK) run++;
+    if (run >= BINARY_RUN_MIN) {
+      _put_nibble(payload, &n, BINARY_RUN);
+      size_t len = run - BINARY_RUN_MIN;
+      do {
+        _put_nibble(payload, &n, (len & 0x7) | (len > 0x7 ? 0x8 : 0));
+        len >>= 3;
+      } while (len);
+      k += run;
+    } else {
+      _put_nibble(payload, &n, s);
+      k++;
     }
-    fprintf(file, "\n");
   }
-  fclose(file);
+  size_t payload_size = (n + 1) / 2;
+
+  memcpy(buf, "LUPB", 4);
+  buf[4] = BINARY_VERSION;
+  buf[5] = (g->wrapping ? BINARY_WRAPPING : 0) | (rle ? BINARY_RLE : 0);
+  buf[6] = buf[7] = 0;
+  _put_u32(buf + 8, g->nb_rows);
+  _put_u32(buf + 12, g->nb_cols);
+  _put_u32(buf + 16, payload_size);
+  _put_u32(buf + 20, _fnv1a(_fnv1a(FNV1A_INIT, buf, 20), payload, payload_size));
+  *size = BINARY_HEADER_SIZE + payload_size;
+  return buf;
 }
 
-/********************************************************************************/
+/* ************************************************************************** */
+
+bool _is_binary(const void* buf, size_t size) { return size >= 4 && memcmp(buf, "LUPB", 4) == 0; }
 
-static void remove_mark(game g)
+/* ************************************************************************** */
+
+static game _binary_error(const char* name, const char* msg)
 {
-  for (uint i = 0; i < g->nb_rows; i++) {
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_get_state(g, i, j) == S_MARK) {
-        game_set_square(g, i, j, S_BLANK);
-      }
+  fprintf(stderr, "%s: invalid binary file: %s\n", name, msg);
+  return NULL;
+}
+
+/* ************************************************************************** */
+
+game _binary_decode(const unsigned char* buf, size_t size, const char* name)
+{
+  if (size < BINARY_HEADER_SIZE || !_is_binary(buf, size)) return _binary_error(name, "bad header");
+  if (buf[4] != BINARY_VERSION) return _binary_error(name, "unsupported version");
+  if (buf[5] & ~(BINARY_WRAPPING | BINARY_RLE)) return _binary_error(name, "unknown options");
+  uint rows = _get_u32(buf + 8), cols = _get_u32(buf + 12);
+  size_t payload_size = _get_u32(buf + 16);
+  const unsigned char* payload = buf + BINARY_HEADER_SIZE;
+  bool rle = buf[5] & BINARY_RLE;
+  uint64_t nb_squares = (uint64_t)rows * cols;
+  if (rows == 0 || cols == 0 || nb_squares > (uint)-1) return _binary_error(name, "bad grid size");
+  if (payload_size != size - BINARY_HEADER_SIZE) return _binary_error(name, "bad payload size");
+  // checked before any allocation: without RLE each square takes one code
+  if (!rle && payload_size != (nb_squares + 1) / 2) return _binary_error(name, "bad payload size");
+  if (_fnv1a(_fnv1a(FNV1A_INIT, buf, 20), payload, payload_size) != _get_u32(buf + 20))
+    return _binary_error(name, "checksum mismatch");
+
+  game g = game_new_empty_ext(rows, cols, buf[5] & BINARY_WRAPPING);
+  square* dst = g->squares;
+  size_t nb_codes = 2 * payload_size;
+  size_t n = 0, k = 0;
+  const char* bad = NULL;
+  if (!rle) {  // fast path: two squares per byte
+    uint invalid = 0;
+    for (; k + 1 < nb_squares; k += 2, n += 2) {
+      square lo = payload[k / 2] & 0xF, hi = payload[k / 2] >> 4;
+      invalid |= !binary_square[lo] | !binary_square[hi];
+      dst[k] = lo;
+      dst[k + 1] = hi;
     }
+    if (invalid) bad = "invalid square";
+  }
+  while (k < nb_squares && !bad) {
+    if (n >= nb_codes) {
+      bad = "truncated grid";
+      break;
+    }
+    uint v = (payload[n / 2] >> (4 * (n % 2))) & 0xF;
+    n++;
+    if (binary_square[v]) {
+      dst[k++] = v;
+    } else if (v == BINARY_RUN && rle) {
+      uint64_t len = 0;
+      uint shift = 0;
+      uint c;
+      do {
+        if (n >= nb_codes || shift > 60) {
+          bad = "truncated run";
+          break;
+        }
+        c = (payload[n / 2] >> (4 * (n % 2))) & 0xF;
+        n++;
+        len |= (uint64_t)(c & 0x7) << shift;
+        shift += 3;
+      } while (c & 0x8);
+      if (!bad && len + BINARY_RUN_MIN > nb_squares - k) bad = "run out of the grid";
+      for (uint64_t r = 0; !bad && r < len + BINARY_RUN_MIN; r++) dst[k++] = S_BLANK;
+    } else {
+      bad = "invalid square";
+    }
+  }
+  // only a padding code may be left
+  if (!bad && (n + 1) / 2 != payload_size) bad = "trailing data";
+  if (bad) {
+    game_delete(g);
+    return _binary_error(name, bad);
   }
   game_update_flags(g);
+  return g;
+}
+
+/* ************************************************************************** */
+
+bool game_save_binary(cgame g, char* filename, bool rle)
+{
+  assert(g);
+  size_t size;
+  unsigned char* buf = _binary_encode(g, rle, &size);
+  if (buf == NULL) {
+    fprintf(stderr, "%s: out of memory\n", filename);
+    return false;
+  }
+  bool ok = _write_atomic(filename, buf, size, false);
+  free(buf);
+  return ok;
+}
+
+/* ************************************************************************** */
+
+size_t game_save_binary_mem(cgame g, char* buf, size_t cap, bool rle)
+{
+  assert(g && (buf || cap == 0));
+  size_t size;
+  unsigned char* bin = _binary_encode(g, rle, &size);
+  if (bin == NULL) return 0;
+  if (size <= cap) memcpy(buf, bin, size);
+  free(bin);
+  return size;
 }
 
+/* ************************************************************************** */
+
+game game_load_binary(char* filename)
+{
+  size_t size;
+  char* buf = _read_file(filename, &size);
+  if (buf == NULL) return NULL;
+  game g = _binary_decode((unsigned char*)buf, size, filename);
+  free(buf);
+  return g;
+}
+
+/* ************************************************************************** */
+/*                            TATHAM DESCRIPTIONS                             */
+/* ************************************************************************** */
+
+/* "<cols>x<rows>[params]:<squares>", where the squares are given row-major:
+ * 'a' to 'z' for a run of 1 to 26 blank squares, '0' to '4' for a numbered
+ * wall and 'B' for an unnumbered wall. */
+
+static game _desc_error(const char* desc, const char* p, const char* msg)
+{
+  fprintf(stderr, "%.*s: invalid game description at %d: %s\n", 40, desc, (int)(p - desc), msg);
+  return NULL;
+}
+
+/* ************************************************************************** */
+
+static bool _desc_uint(const char** p, uint* value)
+{
+  uint64_t v = 0;
+  const char* q = *p;
+  for (; *q >= '0' && *q <= '9'; q++)
+    if ((v = v * 10 + (*q - '0')) > (uint)-1) return false;
+  if (q == *p) return false;
+  *value = (uint)v;
+  *p = q;
+  return true;
+}
+
+/* ************************************************************************** */
+
+game game_from_desc(const char* desc)
+{
+  assert(desc);
+  const char* p = desc;
+  uint rows, columns;
+  if (!_desc_uint(&p, &columns) || *p++ != 'x' || !_desc_uint(&p, &rows))
+    return _desc_error(desc, p, "expected <cols>x<rows>");
+  if (rows == 0 || columns == 0) return _desc_error(desc, p, "empty grid");
+  if ((uint64_t)rows * columns > (uint)-1) return _desc_error(desc, p, "grid too large");
+  while (*p != ':')  // parameters of a full Tatham game ID, such as "b20s2d0"
+    if (*p++ == '\0') return _desc_error(desc, p - 1, "expected ':'");
+  const char* squares = ++p;
+  // checked before any allocation: each character stands for 1 to 26 squares
+  if ((uint64_t)strlen(squares) * 26 < (uint64_t)rows * columns) return _desc_error(desc, p, "too few squares");
+
+  game g = game_new_empty_ext(rows, columns, false);
+  uint n = rows * columns, k = 0;
+  bool overflow = false;
+  for (; *p != '\0'; p++) {
+    uint run = 1;
+    square s = S_BLANK;
+    if (*p >= 'a' && *p <= 'z')
+      run = *p - 'a' + 1;
+    else if (*p >= '0' && *p <= '4')
+      s = S_BLACK0 + (*p - '0');
+    else if (*p == 'B')
+      s = S_BLACKU;
+    else {
+      game_delete(g);
+      return _desc_error(desc, p, "invalid square character");
+    }
+    if ((overflow = (run > n - k))) break;
+    g->squares[k] = s;  // blank squares are already blank
+    k += run;
+  }
+  if (overflow || k != n) {
+    game_delete(g);
+    return _desc_error(desc, p, overflow ? "too many squares" : "too few squares");
+  }
+  game_update_flags(g);
+  return g;
+}
+
+/* ************************************************************************** */
+
+bool game_to_desc(cgame g, char* buf, size_t size)
+{
+  assert(g && buf);
+  if (g->wrapping) return false;  // not supported by the Tatham format
+  int len = snprintf(buf, size, "%ux%u:", g->nb_cols, g->nb_rows);
+  if (len < 0 || (size_t)len >= size) return false;
+  char* p = buf + len;
+  char* end = buf + size - 1;  // room for the final '\0'
+  uint n = g->nb_rows * g->nb_cols, run = 0;
+  for (uint k = 0; k <= n; k++) {
+    square s = (k < n) ? g->squares[k] & S_MASK : S_BLACKU;
+    if (k < n && s < S_BLACK) {  // lightbulbs and marks are not part of the puzzle
+      run++;
+      continue;
+    }
+    for (; run > 0; run -= (run > 26 ? 26 : run)) {
+      if (p == end) return false;
+      *p++ = 'a' + (run > 26 ? 26 : run) - 1;
+    }
+    if (k == n) break;
+    if (p == end) return false;
+    *p++ = (s == S_BLACKU) ? 'B' : '0' + (s - S_BLACK0);
+  }
+  *p = '\0';
+  return true;
+}
+
+/* ************************************************************************** */
+/*                                BATCHED MOVES                               */
+/* ************************************************************************** */
+
+uint game_play_moves(game g, const uint* moves, uint nb_moves)
+{
+  assert(g);
+  assert(moves || nb_moves == 0);
+  uint k = 0;
+  for (; k < nb_moves; k++) {
+    uint i = moves[3 * k], j = moves[3 * k + 1];
+    square s = moves[3 * k + 2];
+    if (!game_check_move(g, i, j, s)) break;
+    // as game_play_move(), but the flags are only updated once, at the end
+    move m = {i, j, STATE(g, i, j), s};
+    SQUARE(g, i, j) = s;
+    _stack_push_move(g->undo_stack, m);
+    if (g->journal) _journal_log(g, J_PLAY, i, j, s);
+  }
+  if (k > 0) {
+    _stack_clear(g->redo_stack);
+    game_update_flags(g);
+  }
+  return k;
+}
+
+/********************************************************************************/
+
 bool game_solve(game g)
 {
-  game_restart(g);
-  game_solve_preprocessing(g);
-  int len = (game_nb_cols(g) * game_nb_rows(g));
-  bool playableSquares[len + 1];
-  game_solve_update_playable_squares(g, playableSquares);
-  unsigned int count = 0;
-  bool worked = game_solve_rec(g, 0, len, &count, false, playableSquares);
-  if (worked) {
-    remove_mark(g);
-    return worked;
-  }
-  game_restart(g);
-  fprintf(stderr, "No solutions for this game\n");
-  return false;
+  assert(g);
+  // the solution is searched from the walls alone, and g is unchanged if there is none
+  game walls = game_copy(g);
+  game_restart(walls);
+  square* solution = malloc(g->nb_rows * g->nb_cols * sizeof(square));
+  assert(solution);
+  bool found = _solve_count(walls, 1, (uint)-1, solution, NULL) == 1;
+  game_delete(walls);
+  if (found) {
+    game_restart(g);
+    for (uint k = 0; k < g->nb_rows * g->nb_cols; k++)
+      if (solution[k] == S_LIGHTBULB) g->squares[k] = S_LIGHTBULB;
+    game_update_flags(g);
+    // the light bulbs are not moves: a new snapshot keeps the journal up to date
+    if (g->journal) game_journal_compact(g);
+  } else {
+    fprintf(stderr, "No solutions for this game\n");
+  }
+  free(solution);
+  return found;
 }
 
 /********************************************************************************/
 
 uint game_nb_solutions(cgame g)
 {
-  game copy = game_copy(g);
-  game_solve_preprocessing(copy);
-  int len = (game_nb_cols(g) * game_nb_rows(g));
-  bool playableSquares[len + 1];
-  game_solve_update_playable_squares(copy, playableSquares);
-  unsigned int count = 0;
-  game_solve_rec(copy, 0, len, &count, true, playableSquares);
-  game_delete(copy);
-  return count;
+  assert(g);
+  return _solve_count(g, (uint)-1, (uint)-1, NULL, NULL);
 }
+
+/********************************************************************************/
+
 static uint nb_neigh_lightbulbs(cgame g, uint i, uint j)
 {
   assert(g);
@@ -165,80 +731,317 @@ static uint nb_neigh_lightbulbs(cgame g, uint i, uint j)
 
 /* ************************************************************************** */
 
-static uint nb_unlit_squares(cgame g)
+#define NOT_IN_SET ((uint)-1)
+
+/* removes square k from the set of unlit squares, in O(1): the set is a dense
+ * array whose last element is moved into the hole, pos[] keeps track of the
+ * position of each square in that array */
+static void _unlit_remove(uint* unlit, uint* pos, uint* nb_unlit, uint k)
 {
-  int nb = 0;
-  for (uint i = 0; i < game_nb_rows(g); i++)
-    for (uint j = 0; j < game_nb_cols(g); j++)
-      if (!game_is_lighted(g, i, j) && game_is_blank(g, i, j)) nb++;
-  return nb;
+  if (pos[k] == NOT_IN_SET) return;
+  uint last = unlit[--(*nb_unlit)];
+  unlit[pos[k]] = last;
+  pos[last] = pos[k];
+  pos[k] = NOT_IN_SET;
 }
 
 /* ************************************************************************** */
 
-/**
- * Create a random game with a given size and number of walls
- *
- * @param nb_rows the number of rows of the game
- * @param nb_cols the number of columns of the game
- * @param wrapping wrapping option
- * @param nb_walls the number of walls to add
- * @param with_solution if true, the game contains the solution, otherwise only walls
- *
- * @return the generated random game
- */
+/* a light bulb has been put at (i,j): removes all the squares it lights from
+ * the set of unlit squares, without recomputing the flags of the whole grid */
+static void _unlit_remove_lighted(cgame g, uint i, uint j, uint* unlit, uint* pos, uint* nb_unlit)
+{
+  _unlit_remove(unlit, pos, nb_unlit, INDEX(g, i, j));
+  direction dirs[] = {UP, DOWN, LEFT, RIGHT};
+  for (uint d = 0; d < 4; d++) {
+    int ii = i;
+    int jj = j;
+    uint dim = (dirs[d] == UP || dirs[d] == DOWN) ? g->nb_rows : g->nb_cols;
+    for (uint k = 1; k < dim; k++) {
+      if (!_next(g, &ii, &jj, dirs[d])) break;
+      if (STATE(g, ii, jj) & S_BLACK) break;
+      _unlit_remove(unlit, pos, nb_unlit, INDEX(g, ii, jj));
+    }
+  }
+}
 
-game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution)
+/* ************************************************************************** */
+
+/* generates a random game, drawing every random number from r */
+static game _game_random(rng* r, uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution)
 {
   assert(nb_walls <= nb_rows * nb_cols);
+  uint nb_squares = nb_rows * nb_cols;
 
   // step 0: create an empty game
   game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
+  uint* unlit = malloc(nb_squares * sizeof(uint));
+  uint* pos = malloc(nb_squares * sizeof(uint));
+  assert(unlit && pos);
+  for (uint k = 0; k < nb_squares; k++) unlit[k] = k;
 
-  // step 1: add random black walls
-  uint k = 0;
-  while (k < nb_walls) {
-    uint i = rand() % nb_rows;
-    uint j = rand() % nb_cols;
-    if (!game_is_black(g, i, j)) {
-      game_set_square(g, i, j, S_BLACKU);
-      k++;
-    }
+  // step 1: add random black walls (partial Fisher-Yates shuffle, no rejection)
+  for (uint k = 0; k < nb_walls; k++) {
+    uint l = k + _rng_below(r, nb_squares - k);
+    uint tmp = unlit[k];
+    unlit[k] = unlit[l];
+    unlit[l] = tmp;
+    g->squares[unlit[k]] = S_BLACKU;
   }
-  game_update_flags(g);
 
-  // step 2: add lightbulbs until every squares are lighted
-  uint nb_unlit = nb_unlit_squares(g);
+  // the squares left in unlit[nb_walls..] are the blank ones: they are all unlit
+  uint nb_unlit = nb_squares - nb_walls;
+  memmove(unlit, unlit + nb_walls, nb_unlit * sizeof(uint));
+  for (uint k = 0; k < nb_squares; k++) pos[k] = NOT_IN_SET;
+  for (uint k = 0; k < nb_unlit; k++) pos[unlit[k]] = k;
+
+  // step 2: add lightbulbs on random unlit squares until every squares are lighted
   while (nb_unlit != 0) {
-    uint random_unlit_num = rand() % nb_unlit;
-    uint num = 0;
-    for (uint i = 0; i < game_nb_rows(g); i++)
-      for (uint j = 0; j < game_nb_cols(g); j++) {
-        if (!game_is_lighted(g, i, j) && game_is_blank(g, i, j)) {
-          if (num == random_unlit_num) {
-            game_set_square(g, i, j, S_LIGHTBULB);
-            game_update_flags(g);
-          }
-          num++;
-        }
-      }
-    nb_unlit = nb_unlit_squares(g);
+    uint k = unlit[_rng_below(r, nb_unlit)];
+    uint i = k / nb_cols;
+    uint j = k % nb_cols;
+    game_set_square(g, i, j, S_LIGHTBULB);
+    _unlit_remove_lighted(g, i, j, unlit, pos, &nb_unlit);
   }
+  free(unlit);
+  free(pos);
 
   // step 3 : set some black wall numbers
   for (uint i = 0; i < game_nb_rows(g); i++)
     for (uint j = 0; j < game_nb_cols(g); j++) {
       if (game_is_black(g, i, j)) {
-        if (rand() % 2 == 0) {
+        if (_rng_below(r, 2) == 0) {
           int nb_lightbulbs = nb_neigh_lightbulbs(g, i, j);
           game_set_square(g, i, j, S_BLACK + nb_lightbulbs);
         }
       }
     }
+  game_update_flags(g);
 
   // check
   assert(game_is_over(g));
 
   if (!with_solution) game_restart(g);
   return g;
-}
\ No newline at end of file
+}
+
+/* ************************************************************************** */
+
+/**
+ * Create a random game with a given size and number of walls
+ *
+ * @param nb_rows the number of rows of the game
+ * @param nb_cols the number of columns of the game
+ * @param wrapping wrapping option
+ * @param nb_walls the number of walls to add
+ * @param with_solution if true, the game contains the solution, otherwise only walls
+ *
+ * @return the generated random game
+ */
+
+game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution)
+{
+  // the seed is drawn from rand(), so that srand() still selects the game
+  uint64_t seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+  return game_random_seeded(nb_rows, nb_cols, wrapping, nb_walls, with_solution, seed);
+}
+
+/* ************************************************************************** */
+
+game game_random_seeded(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution, uint64_t seed)
+{
+  rng r;
+  _rng_seed(&r, seed);
+  return _game_random(&r, nb_rows, nb_cols, wrapping, nb_walls, with_solution);
+}
+
+/* ************************************************************************** */
+
+/* numbers every wall after the light bulbs around it */
+static void _number_walls(game g)
+{
+  for (uint i = 0; i < g->nb_rows; i++)
+    for (uint j = 0; j < g->nb_cols; j++)
+      if (game_is_black(g, i, j)) game_set_square(g, i, j, S_BLACK + nb_neigh_lightbulbs(g, i, j));
+}
+
+/* ************************************************************************** */
+
+/* the first light bulb seen from square (i,j) in direction dir, or NOT_IN_SET */
+static uint _lightbulb_seen(cgame g, uint i, uint j, direction dir)
+{
+  int ii = i;
+  int jj = j;
+  uint dim = (dir == UP || dir == DOWN) ? g->nb_rows : g->nb_cols;
+  for (uint k = 1; k < dim; k++) {
+    if (!_next(g, &ii, &jj, dir)) break;
+    if (STATE(g, ii, jj) & S_BLACK) break;
+    if (STATE(g, ii, jj) == S_LIGHTBULB) return INDEX(g, ii, jj);
+  }
+  return NOT_IN_SET;
+}
+
+/* ************************************************************************** */
+
+/* the blank square k of a solution has been turned into a wall: adds
+ * light bulbs on random unlit squares until every square is lit again; only
+ * the squares seen from k can be unlit, and the set of unlit squares is then
+ * kept up to date like in _game_random() (pos is NOT_IN_SET on entry and exit) */
+static void _light_all(game g, uint k, uint* unlit, uint* pos, rng* r)
+{
+  direction dirs[] = {UP, DOWN, LEFT, RIGHT};
+  uint nb_unlit = 0;
+  for (uint d = 0; d < 4; d++) {
+    int ii = k / g->nb_cols;
+    int jj = k % g->nb_cols;
+    uint dim = (dirs[d] == UP || dirs[d] == DOWN) ? g->nb_rows : g->nb_cols;
+    for (uint l = 1; l < dim; l++) {
+      if (!_next(g, &ii, &jj, dirs[d])) break;
+      if (STATE(g, ii, jj) & S_BLACK) break;
+      uint m = INDEX(g, ii, jj);
+      if (STATE(g, ii, jj) != S_BLANK || pos[m] != NOT_IN_SET) continue;
+      bool lit = false;
+      for (uint e = 0; e < 4 && !lit; e++) lit = _lightbulb_seen(g, ii, jj, dirs[e]) != NOT_IN_SET;
+      if (lit) continue;
+      pos[m] = nb_unlit;
+      unlit[nb_unlit++] = m;
+    }
+  }
+  while (nb_unlit != 0) {
+    uint m = unlit[_rng_below(r, nb_unlit)];
+    g->squares[m] = S_LIGHTBULB;
+    _unlit_remove_lighted(g, m / g->nb_cols, m % g->nb_cols, unlit, pos, &nb_unlit);
+  }
+}
+
+/* ************************************************************************** */
+
+/* turns a random wall (other than square k) back into a blank square or a
+ * light bulb, such that the light bulbs of the game are still a solution: the
+ * walls are unnumbered, so only the light bulbs seen from the wall matter */
+static bool _remove_random_wall(game g, uint k, uint* walls, rng* rnd)
+{
+  uint nb_walls = 0;
+  for (uint l = 0; l < g->nb_rows * g->nb_cols; l++)
+    if ((g->squares[l] & S_BLACK) && l != k) {
+      walls[nb_walls++] = l;
+      g->squares[l] = S_BLACKU;  // numbers are set again afterwards
+    }
+  g->squares[k] = S_BLACKU;
+  while (nb_walls > 0) {
+    uint r = _rng_below(rnd, nb_walls);
+    uint w = walls[r];
+    walls[r] = walls[--nb_walls];
+    uint i = w / g->nb_cols;
+    uint j = w % g->nb_cols;
+    uint up = _lightbulb_seen(g, i, j, UP), down = _lightbulb_seen(g, i, j, DOWN);
+    uint left = _lightbulb_seen(g, i, j, LEFT), right = _lightbulb_seen(g, i, j, RIGHT);
+    // a blank square must be lit, and must not join two light bulbs of its row
+    // or column (with wrapping, both sides may see the same light bulb)
+    bool lit = up != NOT_IN_SET || down != NOT_IN_SET || left != NOT_IN_SET || right != NOT_IN_SET;
+    bool col_joined = up != NOT_IN_SET && down != NOT_IN_SET && up != down;
+    bool row_joined = left != NOT_IN_SET && right != NOT_IN_SET && left != right;
+    if (lit && !col_joined && !row_joined) {
+      g->squares[w] = S_BLANK;
+      return true;
+    }
+    // a light bulb must not see any other one
+    if (!lit) {
+      g->squares[w] = S_LIGHTBULB;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ************************************************************************** */
+
+/* lists the light bulbs of another solution which are not light bulbs in g */
+static uint _other_lightbulbs(cgame g, square* other, uint* list)
+{
+  uint nb = 0;
+  for (uint k = 0; k < g->nb_rows * g->nb_cols; k++)
+    if (other[k] == S_LIGHTBULB && (g->squares[k] & S_MASK) != S_LIGHTBULB) list[nb++] = k;
+  return nb;
+}
+
+/* ************************************************************************** */
+
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, uint64_t seed, uint* nb_attempts)
+{
+  assert(nb_walls <= nb_rows * nb_cols);
+  uint nb_squares = nb_rows * nb_cols;
+  rng r;
+  _rng_seed(&r, seed);
+  uint* walls = malloc((nb_squares + 1) * sizeof(uint));
+  uint* pos = malloc((nb_squares + 1) * sizeof(uint));
+  square* other = malloc((nb_squares + 1) * sizeof(square));
+  assert(walls && pos && other);
+  for (uint k = 0; k < nb_squares; k++) pos[k] = NOT_IN_SET;
+
+  for (uint attempt = 0; attempt < RANDOM_UNIQUE_ATTEMPTS; attempt++) {
+    // step 1: start from a random solution with every wall numbered (most clues)
+    game g = _game_random(&r, nb_rows, nb_cols, wrapping, nb_walls, true);
+    game p = NULL;
+    for (uint repair = 0; repair <= nb_squares; repair++) {
+      _number_walls(g);
+      p = game_copy(g);
+      game_restart(p);
+      uint nb = _solve_count(p, 2, RANDOM_UNIQUE_BUDGET, other, NULL);
+      if (nb == 1) break;
+
+      // step 2: the light bulbs do not decide the game yet: turn a light bulb of
+      // another solution into a wall (our solution is lit again if needed), and
+      // give a wall back elsewhere so that the number of walls is kept; a search
+      // out of budget gives up the attempt
+      game_delete(p);
+      p = NULL;
+      if (nb == SOLVE_UNKNOWN) break;
+      uint nb_cand = _other_lightbulbs(g, other, walls);
+      if (nb_cand == 0) {  // we got our own solution back, ask for the first one
+        game q = game_copy(g);
+        game_restart(q);
+        nb = _solve_count(q, 1, RANDOM_UNIQUE_BUDGET, other, NULL);
+        game_delete(q);
+        if (nb == SOLVE_UNKNOWN) break;
+        nb_cand = _other_lightbulbs(g, other, walls);
+      }
+      assert(nb_cand > 0);
+      uint k = walls[_rng_below(&r, nb_cand)];
+      g->squares[k] = S_BLACKU;
+      _light_all(g, k, walls, pos, &r);
+      if (!_remove_random_wall(g, k, walls, &r)) break;
+    }
+    game_delete(g);
+    if (!p) continue;
+
+    // step 3: remove the numbers one at a time, in random order, as long as the
+    // solution stays unique; the remaining numbers are a minimal clue set, but
+    // for the numbers kept because the search ran out of budget
+    uint n = 0;
+    for (uint k = 0; k < nb_squares; k++)
+      if (p->squares[k] & S_BLACK) walls[n++] = k;
+    for (uint l = n; l > 1; l--) {
+      uint m = _rng_below(&r, l);
+      uint tmp = walls[l - 1];
+      walls[l - 1] = walls[m];
+      walls[m] = tmp;
+    }
+    for (uint k = 0; k < n; k++) {
+      square s = p->squares[walls[k]];
+      p->squares[walls[k]] = S_BLACKU;
+      if (_solve_count(p, 2, RANDOM_UNIQUE_BUDGET, NULL, NULL) != 1) p->squares[walls[k]] = s;
+    }
+    game_update_flags(p);
+    free(walls);
+    free(pos);
+    free(other);
+    if (nb_attempts) *nb_attempts = attempt + 1;
+    return p;
+  }
+  free(walls);
+  free(pos);
+  free(other);
+  if (nb_attempts) *nb_attempts = RANDOM_UNIQUE_ATTEMPTS;
+  return NULL;
+}
@@ -9,6 +9,7 @@
 #ifndef __GAME_TOOLS_H__
 #define __GAME_TOOLS_H__
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "game.h"
@@ -21,18 +22,137 @@
 /**
  * @brief Creates a game by loading its description from a text file.
  * @details See the file format description in @ref index.
+ * A binary file (see @ref game_save_binary) is detected and loaded as well.
  * @param filename input file
- * @return the loaded game
+ * @return the loaded game, or NULL if the file can not be read or is not valid
+ * (the error is reported on stderr, with its line and column)
  **/
 game game_load(char* filename);
 
+/**
+ * @brief Creates a game from a save file held in memory.
+ * @details Same as @ref game_load, without any file: @p buf holds the content
+ * of a text or binary save file, as written by @ref game_save_mem or
+ * @ref game_save_binary_mem.
+ * @param buf the content of the save file, which does not need a terminating
+ * '\0'
+ * @param len the size of the content, in bytes
+ * @return the loaded game, or NULL if the content is not valid (reported on
+ * stderr)
+ **/
+game game_load_mem(const char* buf, size_t len);
+
 /**
  * @brief Saves a game in a text file.
- * @details See the file format description in @ref index.
+ * @details See the file format description in @ref index. The file is written
+ * in one go to a new temporary file next to it, which is then renamed over
+ * @p filename: if the program dies during the save, the previous file is kept.
+ * @param g game to save
+ * @param filename output file
+ * @return true if the game has been saved, false otherwise (the error is
+ * reported on stderr and @p filename is left unchanged)
+ **/
+bool game_save(cgame g, char* filename);
+
+/**
+ * @brief Saves a game in a text file, and waits for it to reach the disk.
+ * @details Same as @ref game_save, but the file and its directory are also
+ * flushed with fsync(), so that the save survives a power loss. This is slower:
+ * use it for saves that must not be lost.
  * @param g game to save
  * @param filename output file
+ * @return true if the game has been saved, false otherwise
+ **/
+bool game_save_sync(cgame g, char* filename);
+
+/**
+ * @brief Saves a game in a memory buffer, in the text format of @ref game_save.
+ * @details Nothing is written if the buffer is too small: the needed size can
+ * be queried with a NULL buffer and a zero capacity. No terminating '\0' is
+ * written.
+ * @param g game to save
+ * @param buf the buffer that receives the text
+ * @param cap the capacity of the buffer, in bytes
+ * @return the size of the text, in bytes (greater than @p cap if nothing has
+ * been written)
+ **/
+size_t game_save_mem(cgame g, char* buf, size_t cap);
+
+/**
+ * @brief Saves a game in a compact binary file.
+ * @details The file holds a 24-byte header (magic number "LUPB", version,
+ * wrapping option, size and checksum) followed by the square states, packed on
+ * 4 bits each. With @p rle, runs of blank squares are run-length encoded, which
+ * makes sparse grids much smaller. The file is written atomically, as with
+ * @ref game_save. The flags are not saved: they are computed again on load.
+ * @param g game to save
+ * @param filename output file
+ * @param rle if true, runs of blank squares are run-length encoded
+ * @return true if the game has been saved, false otherwise
+ **/
+bool game_save_binary(cgame g, char* filename, bool rle);
+
+/**
+ * @brief Saves a game in a memory buffer, in the format of @ref game_save_binary.
+ * @details As with @ref game_save_mem, nothing is written if the buffer is too
+ * small, and the needed size can be queried with a NULL buffer.
+ * @param g game to save
+ * @param buf the buffer that receives the binary data
+ * @param cap the capacity of the buffer, in bytes
+ * @param rle if true, runs of blank squares are run-length encoded
+ * @return the size of the binary data, in bytes (greater than @p cap if
+ * nothing has been written), or 0 if out of memory
+ **/
+size_t game_save_binary_mem(cgame g, char* buf, size_t cap, bool rle);
+
+/**
+ * @brief Creates a game by loading it from a binary file.
+ * @details See @ref game_save_binary. Note that @ref game_load also detects
+ * and loads binary files.
+ * @param filename input file
+ * @return the loaded game, or NULL if the file can not be read or is not valid
+ * (bad header, size or checksum, reported on stderr)
+ **/
+game game_load_binary(char* filename);
+
+/**
+ * @brief Creates a game from a Simon Tatham's Light Up description.
+ * @details The description is "<cols>x<rows>:<squares>", as in the game ID
+ * "7x7:b1f2iB2g1Bi2fBb" of @ref game_default, where the squares are given
+ * row-major: 'a' to 'z' for a run of 1 to 26 blank squares, '0' to '4' for a
+ * numbered wall and 'B' for an unnumbered wall. A full game ID, with
+ * parameters before the colon (such as "7x7b20s2d0:..."), is also accepted.
+ * The game is not wrapping.
+ * @param desc the description
+ * @return the created game, or NULL if the description is not valid (reported
+ * on stderr)
+ **/
+game game_from_desc(const char* desc);
+
+/**
+ * @brief Writes the Simon Tatham's Light Up description of a game.
+ * @details See @ref game_from_desc. Only the walls are described: lightbulbs
+ * and marks are left out. A buffer of nb_rows * nb_cols + 24 bytes is always
+ * large enough.
+ * @param g the game
+ * @param buf the buffer that receives the description, '\0'-terminated
+ * @param size the size of the buffer
+ * @return true if the description has been written, false if the buffer is
+ * too small or if the game is wrapping (which the format does not support)
  **/
-void game_save(cgame g, char* filename);
+bool game_to_desc(cgame g, char* buf, size_t size);
+
+/**
+ * @brief Plays a list of moves.
+ * @details Same as calling @ref game_play_move on each move in turn, each one
+ * being undoable on its own, but the flags are only updated once, at the end.
+ * The moves are played up to the first one rejected by @ref game_check_move.
+ * @param g the game
+ * @param moves the moves, as nb_moves triples (i, j, s)
+ * @param nb_moves the number of moves
+ * @return the number of moves played
+ **/
+uint game_play_moves(game g, const uint* moves, uint nb_moves);
 
 /**
  * @brief Computes the solution of a given game
@@ -66,6 +186,72 @@ uint game_nb_solutions(cgame g);
 
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution);
 
+/**
+ * Create a random game with a given size and number of walls, from a seed
+ *
+ * @details Unlike @ref game_random, which draws its seed from rand(), the
+ * generator state is local to the call: it does not touch the global state of
+ * rand() and can run concurrently in several threads. The same seed gives the
+ * same game on every platform.
+ *
+ * @param nb_rows the number of rows of the game
+ * @param nb_cols the number of columns of the game
+ * @param wrapping wrapping option
+ * @param nb_walls the number of walls to add
+ * @param with_solution if true, the game contains the solution, otherwise only walls
+ * @param seed the random seed
+ *
+ * @return the generated random game
+ */
+game game_random_seeded(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution, uint64_t seed);
+
+/**
+ * @brief Maximum number of random solutions tried by @ref game_random_unique.
+ **/
+#define RANDOM_UNIQUE_ATTEMPTS 1000
+
+/**
+ * @brief Maximum number of guesses of each solver search run by @ref
+ * game_random_unique, which bounds the time spent on one random solution.
+ **/
+#define RANDOM_UNIQUE_BUDGET 100
+
+/**
+ * Create a random game with a given size and number of walls, which has exactly
+ * one solution
+ *
+ * @details The generator starts from a random solution, drawn like the one of
+ * @ref game_random_seeded, with every wall numbered. As long as other solutions
+ * remain, the walls are repaired: a light bulb of another solution is turned
+ * into a wall, new light bulbs light the squares left unlit, and another wall
+ * is turned back into a square, so that the number of walls is kept. The
+ * returned walls are therefore usually not those of game_random_seeded() with
+ * the same seed. Once the solution is unique, the wall numbers are removed one
+ * at a time as long as the solution stays unique. The remaining numbers are a
+ * minimal set of clues: removing any of them would allow other solutions.
+ *
+ * Each search for other solutions stops after RANDOM_UNIQUE_BUDGET guesses. A
+ * repair whose search runs out of budget gives up the random solution, and a
+ * number whose removal cannot be decided within the budget is kept, so that
+ * the clues of large boards may not be minimal. Boards up to about 30x30 take
+ * well under a second; beyond that, most random solutions are given up (about
+ * 15 per game at 50x50), and the generator may return NULL on very large ones.
+ *
+ * @param nb_rows the number of rows of the game
+ * @param nb_cols the number of columns of the game
+ * @param wrapping wrapping option
+ * @param nb_walls the number of walls to add
+ * @param seed the random seed, the same seed gives the same game on every
+ * platform (the generator state is local to the call, see @ref game_random_seeded)
+ * @param nb_attempts if not NULL, receives the number of random solutions tried,
+ * from 1 to RANDOM_UNIQUE_ATTEMPTS
+ *
+ * @return the generated game (without its solution), or NULL if no game with a
+ * unique solution was found after RANDOM_UNIQUE_ATTEMPTS tries (for instance,
+ * an open 2x2 board always has 2 solutions)
+ */
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, uint64_t seed, uint* nb_attempts);
+
 /**
  * @}
  */
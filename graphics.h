@@ -13,23 +13,81 @@
 
 #include "game.h"
 
+/* performance overlay */
+#define HUD_FRAMES 120    // frames in the rolling window
+#define HUD_BUCKETS 16    // bars of the frame-time histogram
+#define HUD_BUCKET_MS 2   // width of a bar, the last one holds the slower frames
+#define HUD_FONTSIZE 14
+
+/* assets decoded by the loader thread, before their upload */
+typedef struct {
+  SDL_Surface* atlas;
+  SDL_Surface* background;
+  SDL_Surface* title;
+  TTF_Font* font_mc;  // kept open for the texts rendered on first use
+  TTF_Font* hud_font;
+} Assets;
+
 struct Env_t {
   game g;
   SDL_Texture** texts;
-  SDL_Texture** textures;
-  int scale;
+  Assets assets;
+  SDL_Thread* loader;    // decodes the assets, NULL once they are uploaded
+  SDL_atomic_t loaded;   // set by the loader when it is done
+  bool loading;          // the assets are not uploaded yet
+  bool startup_log;      // prints the startup times (-t)
+  SDL_Texture* atlas;  // every tile, see TILE_COUNT
+  SDL_Texture* background;
+  SDL_Vertex* batch;  // quads to draw from the atlas, 4 vertices each
+  int* batch_indices;
+  int batch_len, batch_capacity;  // in quads
+  int square_size;  // in pixels, at the current zoom
+  SDL_Rect view;    // part of the window where the grid is drawn
+  double zoom;      // 1 when the whole grid fits in the window
+  double cam_x, cam_y;      // square at the top left corner of the view, fractional
+  int origin_x, origin_y;   // position in the window of the top left corner of the grid
+  uint row0, row1, col0, col1;  // visible squares: rows [row0, row1), columns [col0, col1)
+  bool pressed;  // a mouse button is down
+  bool dragged;  // the mouse moved since, the grid is panned instead of played
+  int press_x, press_y;
   int padding_w;
   int padding_h;
   int bar_start_w;
   int bar_start_h;
   int bar_scale;
   uint woncount;
+  bool redraw;     // the window must be rendered again
+  SDL_Texture* board;  // cached rendering of the grid, NULL if not supported
+  int board_w, board_h;
+  int board_square_size;  // square size of the board texture content
+  uint board_row0, board_col0;  // square at the top left corner of the board texture
+  square* shown;     // squares as last rendered into the board, row-major
+  bool board_valid;  // false when every square must be rendered again
+  bool animating;  // render() needs another frame, DELAY ms later
+  bool hud;        // the performance overlay is shown (F3)
+  FILE* csv;  // statistics of every frame, NULL if not asked for (-p)
+  uint nb_frames;
+  double frame_ms[HUD_FRAMES];  // last frames, from the start of render() to the end of the present
+  Uint32 frame_ticks[HUD_FRAMES];
+  double render_ms, process_ms;  // of the last frame
+  uint draw_calls;               // of the current render()
+  const char* engine_call;       // last engine call, NULL if none
+  double engine_ms;
+  bool engine_logged;  // the last engine call is already in the CSV
   Mix_Music* ost;
   Mix_Chunk* won;
 };
 
 typedef struct Env_t Env;
 
+/* times an engine call made from the frontend, for the overlay */
+#define ENGINE_CALL(env, name, call)                    \
+  do {                                                  \
+    Uint64 _engine_start = SDL_GetPerformanceCounter(); \
+    call;                                               \
+    _engine_done(env, name, _engine_start);             \
+  } while (0)
+
 /* **************************************************************** */
 
 #ifdef __ANDROID__
@@ -59,9 +117,15 @@ typedef struct Env_t Env;
 #define APP_NAME "LightUpCraft"
 #define SCREEN_WIDTH 700
 #define SCREEN_HEIGHT 600
-#define DELAY 30
+#define DELAY 30         // ms between two frames of an animation
+#define IDLE_DELAY 1000  // ms between two wake-ups without any event
 #define PADDING_X 20  // padding (in percentage) arount the game grid
 #define PADDING_Y 23
+#define MIN_SQUARE_SIZE 4     // in pixels, bounds the zoom out
+#define MAX_SQUARE_SIZE 128   // in pixels, bounds the zoom in
+#define ZOOM_STEP 1.25        // zoom factor of a mouse wheel notch
+#define PINCH_SPEED 4.0       // zoom factor of a pinch, per screen size
+#define DRAG_THRESHOLD 8      // pixels the mouse moves before a click becomes a drag
 
 /* **************************************************************** */
 
@@ -99,6 +163,17 @@ typedef struct Env_t Env;
 #define TEXTURE_BTN_SOLVE TEXTURE_COUNT + 3
 #define TEXTURE_BTN_REDO TEXTURE_COUNT + 4
 
+/* The atlas holds, in tiles of ATLAS_TILE x ATLAS_TILE pixels, every image
+ * but the background (tile i for texture i), the digits of the walls and a
+ * solid black tile. */
+#define TILE_TEXT(n) (TEXTURE_COUNT + BUTTON_COUNT + (n))
+#define TILE_SOLID TILE_TEXT(TEXT_WINNING)
+#define TILE_COUNT (TILE_SOLID + 1)
+#define ATLAS_TILE 64
+#define ATLAS_COLS 8
+#define ATLAS_W (ATLAS_COLS * ATLAS_TILE)
+#define ATLAS_H (((TILE_COUNT + ATLAS_COLS - 1) / ATLAS_COLS) * ATLAS_TILE)
+
 /* **************************************************************** */
 
 /**
@@ -153,17 +228,128 @@ bool process(SDL_Window* win, SDL_Renderer* ren, Env* env, SDL_Event* e);
 void _get_square_texture(cgame g, uint i, uint j, int* texture_level);
 
 /**
- * @brief updates the renderer with one of the square texture
+ * @brief adds one of the square textures to the batch
  *
  * @param env the environment with the variables
- * @param ren the renderer
  * @param i row
  * @param j column
  * @param square_size size in pixel of the square
  * @param texture_level int array of size 4 with the textures indexes
  * @pre @p texture_level must be at least of size 4 and already have the textures indexes loaded
  */
-void _render_square(Env* env, SDL_Renderer* ren, uint i, uint j, int square_size, int* texture_level);
+void _render_square(Env* env, uint i, uint j, int square_size, int* texture_level);
+
+void _render_square_at(Env* env, int x, int y, int square_size, int* texture_level);
+
+SDL_Rect _tile_rect(int tile);
+
+void _atlas_put(SDL_Surface* atlas, int tile, SDL_Surface* surf);
+
+void _batch_tile(Env* env, int tile, int x, int y, int size);
+
+void _batch_flush(SDL_Renderer* ren, Env* env);
+
+bool _update_board(SDL_Renderer* ren, Env* env, int square_size);
+
+/**
+ * @brief updates the camera for the window size
+ *
+ * @details computes the size of the squares from the zoom, the view and the
+ * range of visible squares, and clamps the zoom and the camera position so that
+ * the view stays on the grid
+ * @param env the environment with the variables
+ * @param w width of the window
+ * @param h height of the window
+ */
+void _camera(Env* env, int w, int h);
+
+/**
+ * @brief zooms in or out, keeping the square under a point of the window in place
+ *
+ * @param env the environment with the variables
+ * @param w width of the window
+ * @param h height of the window
+ * @param factor zoom factor, greater than 1 to zoom in
+ * @param x x of the fixed point
+ * @param y y of the fixed point
+ */
+void _zoom_at(Env* env, int w, int h, double factor, int x, int y);
+
+/**
+ * @brief moves the grid under the view
+ *
+ * @param env the environment with the variables
+ * @param w width of the window
+ * @param h height of the window
+ * @param dx horizontal move, in pixels
+ * @param dy vertical move, in pixels
+ */
+void _pan(Env* env, int w, int h, int dx, int dy);
+
+/**
+ * @brief decodes the images, renders the texts and packs the atlas, on the
+ * loader thread
+ *
+ * @param data the environment
+ * @returns 0
+ */
+int _load_assets(void* data);
+
+/**
+ * @brief uploads the assets decoded by the loader thread to the renderer
+ *
+ * @param ren the renderer
+ * @param env the environment with the variables
+ * @param wait if true, waits for the loader, otherwise returns false if it is
+ * not done yet
+ * @returns true if the assets are uploaded
+ */
+bool _upload_assets(SDL_Renderer* ren, Env* env, bool wait);
+
+/**
+ * @brief prints the time elapsed since SDL_Init() at a step of the startup, with -t
+ *
+ * @param env the environment with the variables
+ * @param what the step
+ */
+void _startup_mark(Env* env, const char* what);
+
+/**
+ * @brief milliseconds elapsed since a performance counter value
+ *
+ * @param start value of SDL_GetPerformanceCounter()
+ * @returns the elapsed time in ms
+ */
+double _ms_since(Uint64 start);
+
+/**
+ * @brief records the duration of an engine call, see ENGINE_CALL
+ *
+ * @param env the environment with the variables
+ * @param name name of the engine function
+ * @param start value of SDL_GetPerformanceCounter() before the call
+ */
+void _engine_done(Env* env, const char* name, Uint64 start);
+
+/**
+ * @brief records the timings of a frame, and writes them to the CSV file if any
+ *
+ * @param env the environment with the variables
+ * @param process_ms time spent in process() since the previous frame
+ * @param render_ms time spent in render()
+ * @param frame_ms time from the start of render() to the end of the present
+ */
+void _hud_frame(Env* env, double process_ms, double render_ms, double frame_ms);
+
+/**
+ * @brief renders the performance overlay: FPS, frame times, last engine call,
+ * draw calls and a histogram of the frame times of the rolling window
+ *
+ * @param win the SDL_window
+ * @param env the environment with the variables
+ * @param ren the renderer
+ */
+void _hud_render(SDL_Window* win, Env* env, SDL_Renderer* ren);
 
 /**
  * @brief renders the menu bar with the buttons icons
@@ -0,0 +1,100 @@
+/**
+ * @file bench_wasm.js
+ * @brief Scalar versus SIMD engine throughput: node bench_wasm.js [rounds]
+ * @details Requires game_worker.js and game_worker_simd.js (make bench). Both
+ * modules are built from the same sources, the second one with -msimd128, which
+ * vectorises the grid kernels of game_private.c (flag reset of
+ * game_update_flags, game_restart, game_equal and game_is_over). For each of
+ * them, the solve throughput is measured on random 7 x 7 and 10 x 10 games, the
+ * move throughput (play_move, is_over, restart) and the game_update_flags
+ * throughput on random 25 x 25 to 200 x 200 games.
+ **/
+
+var rounds = parseInt(process.argv[2] || '5', 10);
+
+const S_BLANK = 0, S_LIGHTBULB = 1;
+
+// best time in ms of rounds runs of fn
+function best(fn) {
+    var min = Infinity;
+    for (var r = 0; r < rounds; r++) {
+        var start = process.hrtime.bigint();
+        fn();
+        min = Math.min(min, Number(process.hrtime.bigint() - start) / 1e6);
+    }
+    return min;
+}
+
+// solves nb random size x size games, from their walls only
+function benchSolve(M, size, nb) {
+    var games = [];
+    for (var k = 0; k < nb; k++) games.push(M._new_random(size, size, 0, (size * size / 5) | 0, 0, k + 1));
+    var ms = best(function () {
+        games.forEach(function (g) { M._restart(g); M._solve(g); });
+    });
+    games.forEach(function (g) { M._delete(g); });
+    return nb / ms * 1e3;
+}
+
+// moves per second on a solved size x size game: each move toggles a
+// lightbulb (its flags are updated incrementally) and is followed by is_over,
+// which scans the whole grid
+function benchMove(M, size, nb) {
+    var g = M._new_random(size, size, 0, (size * size / 5) | 0, 1, size);
+    var cells = [];
+    for (var i = 0; i < size; i++)
+        for (var j = 0; j < size; j++)
+            if (M._is_lightbulb(g, i, j)) cells.push([i, j]);
+    var ms = best(function () {
+        for (var k = 0; k < nb; k++) {
+            var c = cells[k % cells.length];
+            M._play_move(g, c[0], c[1], S_BLANK);
+            M._is_over(g);
+            M._play_move(g, c[0], c[1], S_LIGHTBULB);
+            M._is_over(g);
+        }
+        M._restart(g);
+    });
+    M._delete(g);
+    return 2 * nb / ms * 1e3;
+}
+
+// full game_update_flags per second on a solved size x size game: the flag
+// reset kernel followed by the lighting of the whole grid
+function benchFlags(M, size, nb) {
+    var g = M._new_random(size, size, 0, (size * size / 5) | 0, 1, size);
+    var ms = best(function () {
+        for (var k = 0; k < nb; k++) M._update_flags(g);
+    });
+    M._delete(g);
+    return nb / ms * 1e3;
+}
+
+async function main() {
+    var modules = [['scalar', require('./game_worker.js')], ['simd', require('./game_worker_simd.js')]];
+    var results = {};
+    for (var m of modules) {
+        var M = await m[1]();
+        results[m[0]] = {
+            'solve 7x7': benchSolve(M, 7, 200),
+            'solve 10x10': benchSolve(M, 10, 20),
+            'move 25x25': benchMove(M, 25, 2000),
+            'move 50x50': benchMove(M, 50, 500),
+            'move 100x100': benchMove(M, 100, 100),
+            'move 200x200': benchMove(M, 200, 25),
+            'flags 25x25': benchFlags(M, 25, 2000),
+            'flags 50x50': benchFlags(M, 50, 500),
+            'flags 100x100': benchFlags(M, 100, 100),
+            'flags 200x200': benchFlags(M, 200, 25)
+        };
+    }
+    console.log('%s %s %s %s', 'benchmark'.padEnd(16), 'scalar/s'.padStart(12), 'simd/s'.padStart(12),
+                'speedup'.padStart(8));
+    Object.keys(results.scalar).forEach(function (name) {
+        var a = results.scalar[name], b = results.simd[name];
+        console.log('%s %s %s %s', name.padEnd(16), a.toFixed(0).padStart(12), b.toFixed(0).padStart(12),
+                    (b / a).toFixed(2).padStart(8));
+    });
+}
+
+main().catch(function (e) { console.error(e); process.exit(1); });
@@ -4,6 +4,7 @@ const myTimeout = setTimeout(start, 500);
 var canvas = document.getElementById('gamedraw');
 var ctx = canvas.getContext('2d');
 var g;
+var solver = new SolverClient();
 var ost = new Audio('textures/ost.mp3')
 var won = new Audio('textures/orb.wav');
 ost.volume=0.4;
@@ -18,6 +19,7 @@ const S_BLACK2 = 10;
 const S_BLACK3 = 11;           
 const S_BLACK4 = 12;           
 const S_BLACKU = 13; 
+const S_MASK = 0x0F;
 const F_LIGHTED = 16;
 const F_ERROR = 32; 
 
@@ -43,6 +45,11 @@ wall_error.src = "textures/wall_error.png";
 var wall = new Image();
 wall.src = "textures/wall.png";
 
+// the cached squares are drawn again once an image is there
+[lightbulb, lightbulb_error, blank, blank_lighted, mark, wall_error, wall].forEach(function (img) {
+    img.addEventListener('load', invalidate);
+});
+
 
 /* ******************** register events ******************** */
 canvas.addEventListener('click', canvasLeftClick);        // left click event
@@ -71,45 +78,88 @@ function win(){
     }
 }
 
-function drawGame(g){
-    var width = canvas.width;
-    var height = canvas.height;
+// geometry of the grid on the canvas, in whole pixels so that a square can be
+// repainted alone without seams
+function layout(g){
     var nb_rows = Module._nb_rows(g);
     var nb_cols = Module._nb_cols(g);
-    var squareX = width/nb_cols;
-    var squareY = height/nb_rows;
-    var squareMin = Math.min(squareX,squareY);
-    
-    ctx.clearRect(0, 0, width, height);
+    var size = Math.floor(Math.min(canvas.width / nb_cols, canvas.height / nb_rows));
+    return {rows: nb_rows, cols: nb_cols, size: size,
+            x: Math.floor((canvas.width - size * nb_cols) / 2),
+            y: Math.floor((canvas.height - size * nb_rows) / 2)};
+}
+
+// last drawn grid (one byte per square, as Module._grid_ptr) and what it was
+// drawn for: only the squares that differ from it are repainted
+var shown = null;
+var shownKey = "";
+
+// the walls and their numbers never change: they are drawn once per layout
+// in an offscreen canvas, and copied from there
+var staticLayer = document.createElement('canvas');
+
+function invalidate(){
+    shown = null;
+    if (g) drawGame(g);
+}
+
+function drawGame(g){
+    var l = layout(g);
+    // the whole grid in one call, one byte (state | flags) per square
+    var ptr = Module._grid_ptr(g);
+    var grid = Module.HEAPU8.subarray(ptr, ptr + Module._grid_len(g));
+    var key = [g, canvas.width, canvas.height, l.rows, l.cols].join();
+    var full = (shown == null || key != shownKey);
+    // a wall that appears, disappears or changes its number (another game at
+    // the same address) makes the static layer stale
+    for (var k = 0; !full && k < grid.length; k++)
+        if (((grid[k] ^ shown[k]) & S_MASK) && ((grid[k] | shown[k]) & S_BLACK)) full = true;
+    if (full) {
+        ctx.clearRect(0, 0, canvas.width, canvas.height);
+        drawStaticLayer(grid, l);
+        shown = new Uint8Array(grid.length);
+        shownKey = key;
+    }
     ctx.imageSmoothingEnabled = false;
-   
-    var paddingX = (width - squareMin*nb_cols)/2
-    var paddingY = (height - squareMin*nb_rows)/2
-    for (var row = 0; row < nb_rows; row++) {
-        for (var col = 0; col < nb_cols; col++) {
-            ctx.save();
-            var black = Module._is_black(g, row, col);
-            var ligthed = Module._is_lighted(g, row, col);
-            var lightbulb = Module._is_lightbulb(g, row, col);
-            var marked = Module._is_marked(g, row, col);
-            var error = Module._has_error(g, row, col);
-
-            if(ligthed)
-                drawBlankLighted(paddingX+squareMin*col, paddingY+squareMin*row, squareMin, squareMin);
-            else
-                drawBlank(paddingX+squareMin*col, paddingY+squareMin*row, squareMin, squareMin);
-
-            if (lightbulb)
-                drawLightbulb(paddingX+squareMin*col, paddingY+squareMin*row, squareMin, squareMin, error);  
-            else if (black)
-                drawWall(paddingX+squareMin*col, paddingY+squareMin*row, squareMin, squareMin, Module._get_black_number(g,row,col), error);
-            else if (marked)
-                drawMark(paddingX+squareMin*col, paddingY+squareMin*row, squareMin, squareMin);
-            ctx.restore(); 
-        }
+    for (var k = 0; k < grid.length; k++) {
+        if (!full && grid[k] == shown[k]) continue;
+        shown[k] = grid[k];
+        drawSquare(grid[k], l.x + l.size * (k % l.cols), l.y + l.size * Math.floor(k / l.cols), l.size);
+    }
+}
+
+function drawStaticLayer(grid, l){
+    staticLayer.width = canvas.width;
+    staticLayer.height = canvas.height;
+    var sctx = staticLayer.getContext('2d');
+    sctx.imageSmoothingEnabled = false;
+    for (var k = 0; k < grid.length; k++) {
+        var state = grid[k] & S_MASK;
+        if (state & S_BLACK)
+            drawWall(sctx, l.x + l.size * (k % l.cols), l.y + l.size * Math.floor(k / l.cols), l.size, l.size,
+                     (state == S_BLACKU) ? -1 : state - S_BLACK);
     }
 }
 
+function drawSquare(square, x, y, size){
+    var state = square & S_MASK;
+    var error = (square & F_ERROR) != 0;
+    ctx.clearRect(x, y, size, size);
+    if (state & S_BLACK) {
+        ctx.drawImage(staticLayer, x, y, size, size, x, y, size, size);
+        if (error) ctx.drawImage(wall_error, x, y, size, size);
+        return;
+    }
+    if (square & F_LIGHTED)
+        drawBlankLighted(x, y, size, size);
+    else
+        drawBlank(x, y, size, size);
+    if (state == S_LIGHTBULB)
+        drawLightbulb(x, y, size, size, error);
+    else if (state == S_MARK)
+        drawMark(x, y, size, size);
+}
+
 function drawLightbulb(x, y, width, height, has_error){
     if (has_error) ctx.drawImage(lightbulb_error, x, y, width, height);
     else ctx.drawImage(lightbulb, x, y, width, height);
@@ -123,42 +173,38 @@ function drawBlankLighted(x, y, width, height){
     ctx.drawImage(blank_lighted, x, y, width, height);
 }
 
-function drawWall(x, y, width, height, wallNumber, has_error){
-    ctx.drawImage(wall, x, y, width, height);
+function drawWall(c, x, y, width, height, wallNumber){
+    c.drawImage(wall, x, y, width, height);
     var fontString = 'bold '+Math.min(width-5, height-5)+'px Impact';
     if (wallNumber != -1){
-        ctx.font = fontString;
-        ctx.fillStyle = 'black';
-        ctx.textBaseline = 'middle';
-        ctx.textAlign = 'center';
-        ctx.fillText(wallNumber, x + (width/2), y + (height/2));
+        c.font = fontString;
+        c.fillStyle = 'black';
+        c.textBaseline = 'middle';
+        c.textAlign = 'center';
+        c.fillText(wallNumber, x + (width/2), y + (height/2));
     }
-    if (has_error) ctx.drawImage(wall_error, x, y, width, height);
 }
 
 function drawMark(x, y, width, height){
     ctx.drawImage(mark, x, y, width, height);
 }
 
+// square under a click, or null outside of the grid
+function clickedSquare(event){
+    var l = layout(g);
+    var col = Math.floor((event.offsetX - l.x) / l.size);
+    var row = Math.floor((event.offsetY - l.y) / l.size);
+    if (row < 0 || row >= l.rows || col < 0 || col >= l.cols) return null;
+    return {row: row, col: col};
+}
+
 function canvasLeftClick(event) {
     event.preventDefault(); // prevent default context menu to appear...
-    // get relative cursor position in canvas
-    console.log("left click at position:", event.offsetX, event.offsetY);
-    var width = canvas.width;
-    var height = canvas.height;
-    var nb_rows = Module._nb_rows(g);
-    var nb_cols = Module._nb_cols(g);
-    var squareMin = Math.min((width/nb_cols),(height/nb_rows));
-    var paddingX = (width - squareMin*nb_cols)/2
-    var paddingY = (height - squareMin*nb_rows)/2
-    var col = Math.floor((event.offsetX - paddingX) / ((width-2*paddingX)/nb_cols));
-    var row = Math.floor((event.offsetY - paddingY) / ((height-2*paddingY)/nb_rows));
-    console.log("game left click coordinates :", row, col);
-
-    if (Module._is_black(g,row,col)) return;
-    var square = Module._get_state(g,row,col);
-    if (square == S_LIGHTBULB) Module._play_move(g, row, col, S_BLANK);
-    else Module._play_move(g, row, col, S_LIGHTBULB);
+    var sq = clickedSquare(event);
+    if (sq == null || Module._is_black(g, sq.row, sq.col)) return;
+    var square = Module._get_state(g, sq.row, sq.col);
+    if (square == S_LIGHTBULB) Module._play_move(g, sq.row, sq.col, S_BLANK);
+    else Module._play_move(g, sq.row, sq.col, S_LIGHTBULB);
     drawGame(g);
     win();
 
@@ -167,33 +213,57 @@ function canvasLeftClick(event) {
 
 function canvasRightClick(event) {
     event.preventDefault(); // prevent default context menu to appear...
-    // get relative cursor position in canvas
-    console.log("right click at position:", event.offsetX, event.offsetY);
-    var width = canvas.width;
-    var height = canvas.height;
-    var nb_rows = Module._nb_rows(g);
-    var nb_cols = Module._nb_cols(g);
-    var col = Math.floor(event.offsetX / (width/nb_cols));
-    var row = Math.floor(event.offsetY / (height/nb_rows));
-    console.log("game right click coordinates :", row, col);
-
-    if (Module._is_black(g,row,col)) return;
-    var square = Module._get_state(g,row,col);
-    if (square == S_MARK) Module._play_move(g, row, col, S_BLANK);
-    else Module._play_move(g, row, col, S_MARK);
+    var sq = clickedSquare(event);
+    if (sq == null || Module._is_black(g, sq.row, sq.col)) return;
+    var square = Module._get_state(g, sq.row, sq.col);
+    if (square == S_MARK) Module._play_move(g, sq.row, sq.col, S_BLANK);
+    else Module._play_move(g, sq.row, sq.col, S_MARK);
     drawGame(g);
     win();
 }
 
 function restart(){
+    solver.cancel();
     Module._restart(g);
     drawGame(g);
     win()
 }
+// the solver runs in a worker (solver_worker.js) so the page keeps drawing meanwhile
 function solve(){
-    Module._solve(g);
-    drawGame(g);
-    win();
+    if (solver.busy()) return;
+    var game = g;
+    var rows = Module._nb_rows(game);
+    var cols = Module._nb_cols(game);
+    var ptr = Module._malloc(rows * cols);
+    Module._export_grid(game, ptr);
+    var grid = Module.HEAPU8.slice(ptr, ptr + rows * cols);
+    Module._free(ptr);
+    document.getElementById('solvegame').disabled = true;
+    solver.solve(rows, cols, Module._is_wrapping(game), grid).then(function (res) {
+        if (res.found && game == g) {
+            // the solution is played as moves, which can be undone
+            var moves = [];
+            for (var k = 0; k < rows * cols; k++)
+                if (res.grid[k] == S_LIGHTBULB) moves.push(Math.floor(k / cols), k % cols, S_LIGHTBULB);
+            Module._restart(game);
+            playMoves(game, moves);
+            drawGame(g);
+            win();
+        }
+    }, function (err) {
+        if (!err.cancelled) console.error(err);
+    }).finally(function () {
+        document.getElementById('solvegame').disabled = false;
+    });
+}
+// plays a list of moves, given as flat (row, col, state) triples, in one call
+function playMoves(game, moves){
+    var n = moves.length / 3;
+    var ptr = Module._malloc(moves.length * 4);
+    Module.HEAPU32.set(moves, ptr >> 2);
+    var played = Module._play_moves(game, ptr, n);
+    Module._free(ptr);
+    return played;
 }
 function undo(){
     Module._undo(g);
@@ -215,7 +285,9 @@ function newgame(){
     var col= generateRandomFloatInRange(3,9);
     var row= generateRandomFloatInRange(3,9);
     var n_w = walls / 100 * (row * col);
-    g= Module._new_random(col,row,wrap,n_w,false);
+    solver.cancel();
+    var seed = Math.floor(Math.random() * 4294967296);
+    g= Module._new_random(col,row,wrap,n_w,false,seed);
     win();
     drawGame(g);
 }
@@ -224,5 +296,5 @@ function resizeCanvas(){
     var size = Math.min(window.innerHeight *0.65, window.innerWidth*0.65) * window.devicePixelRatio;
     canvas.height = size;
     canvas.width = size;
-    drawGame(g);
+    invalidate();  // the canvas is cleared, even at the same size
 }
\ No newline at end of file
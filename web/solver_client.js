@@ -0,0 +1,89 @@
+/**
+ * @file solver_client.js
+ * @brief Main thread side of the solver worker (see solver_worker.js).
+ * @details The solver itself is synchronous C code, so a request in progress
+ * can only be cancelled by terminating the worker: cancel() does so, rejects
+ * the pending requests and lazily spawns a fresh worker for the next one.
+ **/
+
+/**
+ * @param createWorker optional factory returning an object with postMessage(),
+ * terminate() and an onmessage(msg) callback slot. Defaults to a browser
+ * Web Worker running solver_worker.js.
+ */
+function SolverClient(createWorker) {
+    this.createWorker = createWorker || function () {
+        var w = new Worker('solver_worker.js');
+        var adapter = {
+            postMessage: function (msg, transfer) { w.postMessage(msg, transfer); },
+            terminate: function () { w.terminate(); },
+            onmessage: null
+        };
+        w.onmessage = function (e) { if (adapter.onmessage) adapter.onmessage(e.data); };
+        return adapter;
+    };
+    this.worker = null;
+    this.nextId = 1;
+    this.requests = {};  // id -> {resolve, reject}
+}
+
+SolverClient.prototype._spawn = function () {
+    var self = this;
+    this.worker = this.createWorker();
+    this.worker.onmessage = function (msg) {
+        var req = self.requests[msg.id];
+        if (!req) return;  // 'ready', or answer to a cancelled request
+        delete self.requests[msg.id];
+        if (msg.type == 'solved') req.resolve({found: msg.found, grid: msg.grid});
+        else if (msg.type == 'counted') req.resolve(msg.count);
+        else req.reject(new Error(msg.message));
+    };
+};
+
+SolverClient.prototype._request = function (type, rows, cols, wrapping, grid) {
+    if (!this.worker) this._spawn();
+    var self = this;
+    var id = this.nextId++;
+    // copy, so that the caller keeps its grid when the buffer is transferred
+    var copy = new Uint8Array(grid);
+    return new Promise(function (resolve, reject) {
+        self.requests[id] = {resolve: resolve, reject: reject};
+        self.worker.postMessage({type: type, id: id, rows: rows, cols: cols, wrapping: !!wrapping, grid: copy},
+                                [copy.buffer]);
+    });
+};
+
+/** resolves with {found, grid}, the solved compact grid */
+SolverClient.prototype.solve = function (rows, cols, wrapping, grid) {
+    return this._request('solve', rows, cols, wrapping, grid);
+};
+
+/** resolves with the number of solutions */
+SolverClient.prototype.count = function (rows, cols, wrapping, grid) {
+    return this._request('count', rows, cols, wrapping, grid);
+};
+
+SolverClient.prototype.busy = function () {
+    return Object.keys(this.requests).length > 0;
+};
+
+/** aborts all pending requests, their promises are rejected with err.cancelled = true */
+SolverClient.prototype.cancel = function () {
+    if (!this.worker) return;
+    this.worker.terminate();
+    this.worker = null;
+    var requests = this.requests;
+    this.requests = {};
+    for (var id in requests) {
+        var err = new Error('cancelled');
+        err.cancelled = true;
+        requests[id].reject(err);
+    }
+};
+
+/** releases the worker */
+SolverClient.prototype.close = function () {
+    this.cancel();
+};
+
+if (typeof module !== 'undefined' && module.exports) module.exports = SolverClient;
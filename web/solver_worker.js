@@ -0,0 +1,75 @@
+/**
+ * @file solver_worker.js
+ * @brief Runs game_solve / game_nb_solutions in a second wasm module instance,
+ * off the main thread (browser Web Worker or node worker_threads).
+ *
+ * Protocol (see solver_client.js):
+ *   in:  {type: 'solve' | 'count', id, rows, cols, wrapping, grid: Uint8Array}
+ *   out: {type: 'ready'}
+ *        {type: 'solved', id, found, grid: Uint8Array}
+ *        {type: 'counted', id, count}
+ *        {type: 'error', id, message}
+ * The grid is the compact one byte per square state exported by wrapper.c.
+ **/
+
+var isNode = (typeof process !== 'undefined') && process.versions && process.versions.node;
+var port;     // {post(msg, transfer), listen(handler)}
+var factory;  // emscripten module factory of game_worker.js
+
+if (isNode) {
+    var parentPort = require('worker_threads').parentPort;
+    port = {
+        post: function (msg, transfer) { parentPort.postMessage(msg, transfer); },
+        listen: function (handler) { parentPort.on('message', handler); }
+    };
+    factory = require('./game_worker.js');
+} else {
+    importScripts('game_worker.js');
+    port = {
+        post: function (msg, transfer) { self.postMessage(msg, transfer); },
+        listen: function (handler) { self.onmessage = function (e) { handler(e.data); }; }
+    };
+    factory = LightupModule;
+}
+
+var Module = null;
+var pending = [];   // requests received before the module is instantiated
+
+// answers a request, an exception (bad request, wasm abort) is answered by an error
+function handle(msg) {
+    try {
+        var size = msg.rows * msg.cols;
+        if (!(msg.grid instanceof Uint8Array) || size == 0 || msg.grid.length != size)
+            throw new Error('expected a grid of ' + msg.rows + ' x ' + msg.cols + ' squares');
+        var ptr = Module._malloc(size);
+        if (!ptr) throw new Error('out of memory');
+        try {
+            Module.HEAPU8.set(msg.grid, ptr);
+            if (msg.type == 'solve') {
+                var found = Module._solve_grid(msg.rows, msg.cols, msg.wrapping, ptr);
+                var grid = Module.HEAPU8.slice(ptr, ptr + size);
+                port.post({type: 'solved', id: msg.id, found: !!found, grid: grid}, [grid.buffer]);
+            } else if (msg.type == 'count') {
+                var count = Module._nb_solutions_grid(msg.rows, msg.cols, msg.wrapping, ptr) >>> 0;
+                port.post({type: 'counted', id: msg.id, count: count});
+            } else {
+                throw new Error('unknown request ' + msg.type);
+            }
+        } finally {
+            Module._free(ptr);
+        }
+    } catch (err) {
+        port.post({type: 'error', id: msg.id, message: String((err && err.message) || err)});
+    }
+}
+
+port.listen(function (msg) {
+    if (Module) handle(msg);
+    else pending.push(msg);
+});
+
+factory().then(function (instance) {
+    Module = instance;
+    port.post({type: 'ready'});
+    while (pending.length) handle(pending.shift());
+});
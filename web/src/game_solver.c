@@ -0,0 +1 @@
+../../game_solver.c
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * @file test_solver.js
+ * @brief Headless test of the solver worker protocol: node test_solver.js
+ * @details Requires game_worker.js / game_worker.wasm (make game_worker.js).
+ **/
+
+var path = require('path');
+var assert = require('assert');
+var Worker = require('worker_threads').Worker;
+var SolverClient = require('./solver_client.js');
+
+const S_BLANK = 0, S_LIGHTBULB = 1, S_BLACK1 = 9, S_BLACK2 = 10, S_BLACKU = 13;
+
+function nodeWorker() {
+    var w = new Worker(path.join(__dirname, 'solver_worker.js'));
+    var adapter = {
+        postMessage: function (msg, transfer) { w.postMessage(msg, transfer); },
+        terminate: function () { w.terminate(); },
+        onmessage: null
+    };
+    w.on('message', function (msg) { if (adapter.onmessage) adapter.onmessage(msg); });
+    return adapter;
+}
+
+// https://www.chiark.greenend.org.uk/~sgtatham/puzzles/js/lightup.html#7x7:b1f2iB2g1Bi2fBb
+function defaultGrid() {
+    var grid = new Uint8Array(49);
+    var walls = [[0, 2, S_BLACK1], [1, 2, S_BLACK2], [2, 5, S_BLACKU], [2, 6, S_BLACK2], [4, 0, S_BLACK1],
+                 [4, 1, S_BLACKU], [5, 4, S_BLACK2], [6, 4, S_BLACKU]];
+    walls.forEach(function (w) { grid[w[0] * 7 + w[1]] = w[2]; });
+    return grid;
+}
+
+async function testSolve(client) {
+    var res = await client.solve(7, 7, false, defaultGrid());
+    assert.ok(res.found);
+    var bulbs = [];
+    res.grid.forEach(function (s, k) { if (s == S_LIGHTBULB) bulbs.push(k); });
+    assert.deepStrictEqual(bulbs, [0, 3, 8, 13, 16, 27, 32, 35, 40, 43]);
+    assert.strictEqual(await client.count(7, 7, false, defaultGrid()), 1);
+    // the 2 light bulbs can not be lit by each other on a wrapping 1x2 board
+    assert.strictEqual(await client.count(1, 2, true, new Uint8Array(2)), 2);
+}
+
+async function testError(client) {
+    // a grid which does not match the board size is answered by an error
+    await assert.rejects(client.solve(7, 7, false, new Uint8Array(3)), /7 x 7/);
+    await assert.rejects(client.count(0, 7, false, new Uint8Array(0)), /0 x 7/);
+    // and the worker goes on answering
+    assert.strictEqual(await client.count(7, 7, false, defaultGrid()), 1);
+}
+
+async function testCancelKeepsMainThreadFree(client) {
+    // an open 12x12 board has 12! solutions: counting them takes ages
+    var ticks = 0, last = Date.now(), worstGap = 0;
+    var timer = setInterval(function () {
+        var now = Date.now();
+        worstGap = Math.max(worstGap, now - last);
+        last = now;
+        ticks++;
+    }, 16);
+    var pending = client.count(12, 12, false, new Uint8Array(144));
+    await new Promise(function (resolve) { setTimeout(resolve, 500); });
+    assert.ok(client.busy());
+    client.cancel();
+    await assert.rejects(pending, function (err) { return err.cancelled === true; });
+    clearInterval(timer);
+    assert.ok(ticks >= 20, 'main thread starved: ' + ticks + ' ticks');
+    assert.ok(worstGap < 100, 'main thread blocked for ' + worstGap + ' ms');
+    // a fresh worker answers after cancellation
+    assert.strictEqual(await client.count(7, 7, false, defaultGrid()), 1);
+}
+
+(async function () {
+    var client = new SolverClient(nodeWorker);
+    try {
+        await testSolve(client);
+        await testError(client);
+        await testCancelKeepsMainThreadFree(client);
+        console.log('test_solver: SUCCESS');
+    } catch (err) {
+        console.error('test_solver: FAILURE', err);
+        process.exitCode = 1;
+    } finally {
+        client.close();
+    }
+})();
@@ -13,6 +13,8 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_journal.h"
+#include "game_private.h"
 #include "game_tools.h"
 
 /* ******************** Game V1 & V2 API ******************** */
@@ -44,6 +46,9 @@ uint nb_rows(cgame g) { return game_nb_rows(g); }
 EMSCRIPTEN_KEEPALIVE
 uint nb_cols(cgame g) { return game_nb_cols(g); }
 
+EMSCRIPTEN_KEEPALIVE
+bool is_wrapping(cgame g) { return game_is_wrapping(g); }
+
 EMSCRIPTEN_KEEPALIVE
 square get_state(cgame g, uint i, uint j) { return game_get_state(g, i, j); }
 
@@ -71,6 +76,9 @@ bool is_lighted(cgame g, uint i, uint j) { return game_is_lighted(g, i, j); }
 EMSCRIPTEN_KEEPALIVE
 bool has_error(cgame g, uint i, uint j) { return game_has_error(g, i, j); }
 
+EMSCRIPTEN_KEEPALIVE
+void update_flags(game g) { game_update_flags(g); }
+
 /* ******************** Game Tools API ******************** */
 
 EMSCRIPTEN_KEEPALIVE
@@ -86,10 +94,110 @@ EMSCRIPTEN_KEEPALIVE
 void redo(game g) { game_redo(g); }
 
 EMSCRIPTEN_KEEPALIVE
-game new_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution)
+game new_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_walls, bool with_solution, uint seed)
+{
+return game_random_seeded(nb_rows, nb_cols, wrapping, nb_walls, with_solution, seed);
+}
+
+/* ******************** Save Buffers API ******************** */
+
+/* The JS side allocates the buffers with _malloc(): a first call with a NULL
+ * buffer returns the size to allocate. */
+
+EMSCRIPTEN_KEEPALIVE
+game load_mem(const char* buf, uint len) { return game_load_mem(buf, len); }
+
+EMSCRIPTEN_KEEPALIVE
+uint save_mem(cgame g, char* buf, uint cap) { return game_save_mem(g, buf, cap); }
+
+EMSCRIPTEN_KEEPALIVE
+uint save_binary_mem(cgame g, char* buf, uint cap, bool rle) { return game_save_binary_mem(g, buf, cap, rle); }
+
+/* ******************** Packed Grid API ******************** */
+
+/* The packed grid is one byte per square, row-major, with its state and flags
+ * as returned by game_get_square(), so that JS reads the whole grid in a
+ * single call, as a Uint8Array over HEAPU8 (made after the call, since the
+ * heap may grow). The buffer belongs to the binding and is overwritten by the
+ * next call. */
+
+static unsigned char* packed = NULL;
+static uint packed_cap = 0;
+
+EMSCRIPTEN_KEEPALIVE
+uint grid_len(cgame g) { return g->nb_rows * g->nb_cols; }
+
+EMSCRIPTEN_KEEPALIVE
+unsigned char* grid_ptr(cgame g)
+{
+  uint len = grid_len(g);
+  if (len > packed_cap) {
+    unsigned char* p = realloc(packed, len);
+    if (!p) return NULL;
+    packed = p;
+    packed_cap = len;
+  }
+  for (uint k = 0; k < len; k++) packed[k] = g->squares[k];
+  return packed;
+}
+
+/* plays n moves given as (i, j, s) uint triples, see game_play_moves() */
+EMSCRIPTEN_KEEPALIVE
+uint play_moves(game g, uint* moves, uint n) { return game_play_moves(g, moves, n); }
+
+/* ******************** Compact Grid API ******************** */
+
+/* The compact grid is one byte per square, row-major, holding only the square
+ * state (flags are recomputed on the other side). It is the message format
+ * exchanged with the solver worker, see solver_worker.js. */
+
+EMSCRIPTEN_KEEPALIVE
+void export_grid(cgame g, unsigned char* grid)
+{
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < game_nb_cols(g); j++) grid[i * game_nb_cols(g) + j] = game_get_state(g, i, j);
+}
+
+EMSCRIPTEN_KEEPALIVE
+game new_from_grid(uint nb_rows, uint nb_cols, bool wrapping, unsigned char* grid)
+{
+  game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++) game_set_square(g, i, j, grid[i * nb_cols + j]);
+  game_update_flags(g);
+  return g;
+}
+
+/* replaces the current squares of g with a solved grid, like game_solve() does */
+EMSCRIPTEN_KEEPALIVE
+void apply_grid(game g, unsigned char* grid)
+{
+  game_restart(g);
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < game_nb_cols(g); j++)
+      if (!game_is_black(g, i, j)) game_set_square(g, i, j, grid[i * game_nb_cols(g) + j]);
+  game_update_flags(g);
+  if (g->journal) game_journal_compact(g);
+}
+
+/* solves the grid in place, returns false (grid unchanged) if there is no solution */
+EMSCRIPTEN_KEEPALIVE
+bool solve_grid(uint nb_rows, uint nb_cols, bool wrapping, unsigned char* grid)
+{
+  game g = new_from_grid(nb_rows, nb_cols, wrapping, grid);
+  bool found = game_solve(g);
+  if (found) export_grid(g, grid);
+  game_delete(g);
+  return found;
+}
+
+EMSCRIPTEN_KEEPALIVE
+uint nb_solutions_grid(uint nb_rows, uint nb_cols, bool wrapping, unsigned char* grid)
 {
-srand(time(NULL)); // radom seed
-return game_random(nb_rows, nb_cols, wrapping, nb_walls, with_solution);
+  game g = new_from_grid(nb_rows, nb_cols, wrapping, grid);
+  uint nb = game_nb_solutions(g);
+  game_delete(g);
+  return nb;
 }
 
 // EOF